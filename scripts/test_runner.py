@@ -14,6 +14,9 @@ def main():
     parser.add_argument(
         "-p", "--pipeline", action="store_true", help="Enable pipelining"
     )
+    parser.add_argument(
+        "-o", "--out-of-order", action="store_true", help="Use out-of-order core"
+    )
     parser.add_argument(
         "-f", "--fail", action="store_true", help="Stop on first failure"
     )
@@ -34,6 +37,8 @@ def main():
         cmd.append("-v")
     if args.pipeline:
         cmd.append("-p")
+    if args.out_of_order:
+        cmd.append("-o")
     if args.fail:
         cmd.append("-f")
     if args.testfile:
@@ -64,5 +69,24 @@ def run_output_tests():
         return 1
 
 
+def run_benchmarks():
+    """Run benchmark.py, passing on all arguments."""
+    src_dir = Path(__file__).parent.parent / "src"
+    bench_script = src_dir / "benchmark.py"
+
+    if not bench_script.exists():
+        print(f"Error: {bench_script} not found", file=sys.stderr)
+        return 1
+
+    try:
+        result = subprocess.run(
+            [sys.executable, str(bench_script), *sys.argv[1:]], cwd=src_dir
+        )
+        return result.returncode
+    except Exception as e:
+        print(f"Error running benchmarks: {e}", file=sys.stderr)
+        return 1
+
+
 if __name__ == "__main__":
     sys.exit(main())
@@ -0,0 +1,455 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    bench.cc - Microbenchmarks of the components on the hot path.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "alu.h"
+#include "csr-file.h"
+#include "inst-decoder.h"
+#include "memory-bus.h"
+#include "memory-control.h"
+#include "memory.h"
+#include "pipeline.h"
+#include "pixel-convert.h"
+#include "stages.h"
+#include "syscalls.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include "XGetopt.h"
+#include <intrin.h>
+#define HAVE_TSC
+#else
+#include <getopt.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+#endif
+
+/* Every benchmark adds the values it computes to this sink, such that
+ * the compiler cannot drop the work being measured.
+ */
+static volatile uint64_t sink;
+
+/* Host time stamp counter, which counts reference cycles at a constant
+ * rate. Zero when the host has none.
+ */
+static inline uint64_t
+readTSC()
+{
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+struct BenchOptions {
+  unsigned repetitions{15};
+  double minRunTime{0.01}; /* seconds */
+  std::string filter{};
+};
+
+/* A benchmark runs body(n), which performs n operations. The number of
+ * operations per run is doubled until a run takes at least minRunTime,
+ * then the run is repeated and the median, the minimum and the relative
+ * standard deviation of the time per operation are reported.
+ */
+template <typename Body>
+static void
+measure(const BenchOptions& options, const std::string& name, Body body)
+{
+  if (name.find(options.filter) == std::string::npos)
+    return;
+
+  using Clock = std::chrono::steady_clock;
+  auto timeRun = [&body](uint64_t n, uint64_t& cycles) {
+    auto start = Clock::now();
+    uint64_t startTSC = readTSC();
+    body(n);
+    cycles = readTSC() - startTSC;
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  };
+
+  uint64_t n = 1024;
+  uint64_t cycles;
+  while (timeRun(n, cycles) < options.minRunTime && n < (1ULL << 40))
+    n *= 2;
+
+  std::vector<double> ns, cyclesPerOp;
+  for (unsigned i = 0; i < options.repetitions; ++i) {
+    ns.push_back(timeRun(n, cycles) * 1e9 / n);
+    cyclesPerOp.push_back(static_cast<double>(cycles) / n);
+  }
+
+  double mean = 0.0;
+  for (double t : ns)
+    mean += t;
+  mean /= ns.size();
+  double variance = 0.0;
+  for (double t : ns)
+    variance += (t - mean) * (t - mean);
+  double stdev = ns.size() > 1 ? std::sqrt(variance / (ns.size() - 1)) : 0.0;
+
+  auto median = [](std::vector<double>& values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+  };
+  double minimum = *std::min_element(ns.begin(), ns.end());
+
+  std::cout << std::left << std::setw(34) << name << std::right
+            << std::fixed << std::setprecision(2) << std::setw(10)
+            << median(ns) << std::setw(10) << minimum << std::setw(7)
+            << std::setprecision(1) << 100.0 * stdev / mean << "%";
+#ifdef HAVE_TSC
+  std::cout << std::setprecision(2) << std::setw(12) << median(cyclesPerOp);
+#else
+  std::cout << std::setw(12) << "-";
+#endif
+  std::cout << std::endl;
+}
+
+/* A representative mix of RV64I instruction words of all formats */
+static const uint32_t instructionMix[] = {
+    0x00020537, /* lui r10, $32 */
+    0x00128293, /* addi r5, r5, $1 */
+    0x00053303, /* ld r6, $0(r10) */
+    0x005303b3, /* add r7, r6, r5 */
+    0x00753423, /* sd r7, $8(r10) */
+    0x0063c433, /* xor r8, r7, r6 */
+    0x00341493, /* slli r9, r8, $3 */
+    0xfe0294e3, /* bne r5, r0, $-24 */
+    0x00010117, /* auipc r2, $16 */
+    0x040000ef, /* jal r1, $64 */
+    0x00008067, /* jalr r0, $0(r1) */
+    0xff412583, /* lw r11, $-12(r2) */
+    0x00354603, /* lbu r12, $3(r10) */
+    0x00c583a3, /* sb r12, $7(r11) */
+    0xf8b500e3, /* beq r10, r11, $-128 */
+    0x02d66063, /* bltu r12, r13, $32 */
+    0xfff7071b, /* addiw r14, r14, $-1 */
+    0x4107d7bb, /* sraw r15, r15, r16 */
+    0x43c85813, /* srai r16, r16, $60 */
+    0x00b538b3, /* sltu r17, r10, r11 */
+    0xc0002573, /* csrrs r10, cycle, r0 */
+};
+
+static constexpr size_t MixSize =
+    sizeof(instructionMix) / sizeof(instructionMix[0]);
+
+static void
+benchDecoder(const BenchOptions& options)
+{
+  InstructionDecoder decoder;
+
+  measure(options, "decoder fields", [&](uint64_t n) {
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+      decoder.setInstructionWord(instructionMix[i % MixSize]);
+      sum += static_cast<uint8_t>(decoder.getOpcode()) + decoder.getRD() +
+             decoder.getRS1() + decoder.getRS2() + decoder.getFunct3() +
+             decoder.getFunct7();
+    }
+    sink = sum;
+  });
+
+  measure(options, "decoder getImmediate", [&](uint64_t n) {
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+      decoder.setInstructionWord(instructionMix[i % MixSize]);
+      sum += decoder.getImmediate();
+    }
+    sink = sum;
+  });
+
+  measure(options, "ControlSignals::setFromInstruction", [&](uint64_t n) {
+    ControlSignals control;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+      decoder.setInstructionWord(instructionMix[i % MixSize]);
+      control.setFromInstruction(decoder);
+      sum += static_cast<uint64_t>(control.getALUOp()) + control.getRegWrite();
+    }
+    sink = sum;
+  });
+}
+
+static void
+benchALU(const BenchOptions& options)
+{
+  static const struct {
+    ALUOp op;
+    const char* name;
+  } ops[] = {{ALUOp::ADD, "add"},   {ALUOp::SUB, "sub"},
+             {ALUOp::SLL, "sll"},   {ALUOp::SLT, "slt"},
+             {ALUOp::SLTU, "sltu"}, {ALUOp::XOR, "xor"},
+             {ALUOp::SRL, "srl"},   {ALUOp::SRA, "sra"},
+             {ALUOp::OR, "or"},     {ALUOp::AND, "and"},
+             {ALUOp::ADDW, "addw"}, {ALUOp::SUBW, "subw"},
+             {ALUOp::SLLW, "sllw"}, {ALUOp::SRLW, "srlw"},
+             {ALUOp::SRAW, "sraw"}};
+
+  ALU alu;
+  for (const auto& op : ops) {
+    measure(options, std::string("ALU ") + op.name, [&](uint64_t n) {
+      alu.setOp(op.op);
+      RegValue value = 0x0123456789abcdefULL;
+      for (uint64_t i = 0; i < n; ++i) {
+        alu.setA(value);
+        alu.setB(i);
+        value = alu.getResult() + 1;
+      }
+      sink = value;
+    });
+  }
+}
+
+/* A memory bus with the given number of clients of size bytes each,
+ * placed next to each other from 0x100000. Accesses cycle through all
+ * clients.
+ */
+static void
+benchMemoryBus(const BenchOptions& options, size_t nClients, size_t size)
+{
+  constexpr MemAddress Base = 0x100000;
+
+  std::vector<std::unique_ptr<MemoryInterface>> clients;
+  for (size_t i = 0; i < nClients; ++i) {
+    auto memory = Memory::createZeroed("client", Base + i * size, size);
+    memory->setMayWrite(true);
+    clients.push_back(std::move(memory));
+  }
+  MemoryBus bus{std::move(clients)};
+
+  std::string name = "MemoryBus read, " + std::to_string(nClients) +
+                     (size < 4096 ? " shared" : " paged");
+  measure(options, name, [&](uint64_t n) {
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < n; ++i)
+      sum += bus.readWord(Base + (i % nClients) * size + (i & 0x3c) % size);
+    sink = sum;
+  });
+}
+
+static void
+benchMemory(const BenchOptions& options)
+{
+  constexpr MemAddress Base = 0x100000;
+  constexpr size_t Size = 64 * 1024;
+
+  auto memory = Memory::createZeroed("ram", Base, Size);
+  memory->setMayWrite(true);
+
+  measure(options, "Memory readDoubleWord", [&](uint64_t n) {
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < n; ++i)
+      sum += memory->readDoubleWord(Base + ((i * 8) & (Size - 1)));
+    sink = sum;
+  });
+
+  measure(options, "Memory writeDoubleWord", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i)
+      memory->writeDoubleWord(Base + ((i * 8) & (Size - 1)), i);
+  });
+
+  measure(options, "Memory readByte", [&](uint64_t n) {
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < n; ++i)
+      sum += memory->readByte(Base + (i & (Size - 1)));
+    sink = sum;
+  });
+
+  measure(options, "Memory writeByte", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i)
+      memory->writeByte(Base + (i & (Size - 1)), i);
+  });
+}
+
+/* An endless loop of loads, stores, ALU instructions and a taken
+ * branch, followed by nops that are fetched speculatively.
+ */
+static const uint32_t pipelineLoop[] = {
+    0x00020537, /* lui r10, $32 */
+    0x00128293, /* addi r5, r5, $1 */
+    0x00053303, /* ld r6, $0(r10) */
+    0x005303b3, /* add r7, r6, r5 */
+    0x00753423, /* sd r7, $8(r10) */
+    0x0063c433, /* xor r8, r7, r6 */
+    0x00341493, /* slli r9, r8, $3 */
+    0xfe0294e3, /* bne r5, r0, $-24 */
+    0x00000013, /* nop */
+    0x00000013, /* nop */
+    0x00000013, /* nop */
+    0x00000013, /* nop */
+};
+
+static void
+benchPipeline(const BenchOptions& options, bool pipelining)
+{
+  constexpr MemAddress TextBase = 0x10000;
+  constexpr MemAddress DataBase = 0x20000;
+
+  auto text = Memory::createZeroed("text", TextBase, 4096);
+  text->initialize(TextBase, reinterpret_cast<const std::byte*>(pipelineLoop),
+                   sizeof(pipelineLoop));
+  text->setMayExecute(true);
+  auto data = Memory::createZeroed("data", DataBase, 4096);
+  data->setMayWrite(true);
+
+  std::vector<std::unique_ptr<MemoryInterface>> clients;
+  clients.push_back(std::move(text));
+  clients.push_back(std::move(data));
+  MemoryBus bus{std::move(clients)};
+
+  MemAddress PC = TextBase;
+  InstructionMemory instructionMemory{bus};
+  DataMemory dataMemory{bus};
+  InstructionDecoder decoder;
+  RegisterFile regfile;
+  CSRFile csrFile;
+  SyscallEmulator syscalls{bus};
+  Pipeline pipeline(pipelining, false, PC, instructionMemory, decoder, regfile,
+                    dataMemory, csrFile, syscalls);
+
+  std::string name = pipelining ? "Pipeline cycle, pipelined"
+                                : "Pipeline cycle, non-pipelined";
+  uint64_t nCycles = 0;
+  measure(options, name, [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i, ++nCycles) {
+      if (nCycles % 5 == 0)
+        bus.clockPulse();
+      pipeline.propagate();
+      pipeline.clockPulse();
+    }
+  });
+  sink = pipeline.getInstrCompleted();
+}
+
+/* The pixel conversion kernels of the framebuffer, per pixel, converting
+ * scanlines of 1024 pixels. All kernels must produce the same output.
+ */
+static void
+benchPixelConvert(const BenchOptions& options)
+{
+  constexpr size_t Width = 1024;
+
+  std::vector<uint8_t> src(Width);
+  std::vector<uint32_t> palette(256), dst(Width), expected(Width);
+  for (size_t i = 0; i < Width; ++i)
+    src[i] = (i * 167 + 13) & 0xff;
+  for (size_t i = 0; i < palette.size(); ++i)
+    palette[i] = 0x9e3779b9U * (i + 1);
+
+  const auto& converters = getPixelConverters();
+  for (const auto& converter : converters) {
+    /* An odd count also covers the scalar tail of the kernels */
+    converters[0].convertY8(expected.data(), src.data(), Width - 3);
+    converter.convertY8(dst.data(), src.data(), Width - 3);
+    bool valid = dst == expected;
+    converters[0].convertIndexed(expected.data(), src.data(), Width - 3,
+                                 palette.data());
+    converter.convertIndexed(dst.data(), src.data(), Width - 3,
+                             palette.data());
+    if (!valid || dst != expected)
+      throw std::runtime_error(std::string("pixel conversion kernel ") +
+                               converter.name + " is incorrect");
+  }
+
+  for (const auto& converter : converters) {
+    measure(options, std::string("convert Y8, ") + converter.name,
+            [&](uint64_t n) {
+              for (uint64_t i = 0; i < n; i += Width)
+                converter.convertY8(dst.data(), src.data(), Width);
+              sink = dst[0];
+            });
+  }
+
+  for (const auto& converter : converters) {
+    measure(options, std::string("convert indexed, ") + converter.name,
+            [&](uint64_t n) {
+              for (uint64_t i = 0; i < n; i += Width)
+                converter.convertIndexed(dst.data(), src.data(), Width,
+                                         palette.data());
+              sink = dst[0];
+            });
+  }
+}
+
+static void
+showHelp(const char* progName)
+{
+  std::cerr << progName << " [-r repetitions] [-t seconds] [filter]"
+            << std::endl;
+  std::cerr << R"HERE(
+    Runs microbenchmarks of the emulator's components and prints the
+    time per operation in nanoseconds (median and minimum over the
+    repetitions, and the relative standard deviation), and the median
+    number of host time stamp counter cycles per operation.
+
+    -r repetitions  number of timed runs per benchmark (default 15)
+    -t seconds      minimum duration of a run (default 0.01)
+    filter          only run the benchmarks whose name contains filter
+)HERE";
+}
+
+int
+main(int argc, char** argv)
+{
+  BenchOptions options;
+  char c;
+
+  while ((c = getopt(argc, argv, "r:t:h")) != -1) {
+    switch (c) {
+    case 'r':
+      options.repetitions = std::max(1, std::atoi(optarg));
+      break;
+
+    case 't':
+      options.minRunTime = std::atof(optarg);
+      break;
+
+    case 'h':
+    default:
+      showHelp(argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind < argc)
+    options.filter = argv[optind];
+
+  std::cout << std::left << std::setw(34) << "benchmark" << std::right
+            << std::setw(10) << "ns/op" << std::setw(10) << "min"
+            << std::setw(8) << "stdev" << std::setw(12) << "cycles/op"
+            << std::endl;
+
+  try {
+    benchDecoder(options);
+    benchALU(options);
+    for (size_t nClients : {1, 4, 16, 64, 256})
+      benchMemoryBus(options, nClients, 4096);
+    for (size_t nClients : {4, 16, 64})
+      benchMemoryBus(options, nClients, 256);
+    benchMemory(options);
+    benchPipeline(options, false);
+    benchPipeline(options, true);
+    benchPixelConvert(options);
+  } catch (std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,362 @@
+#!/usr/bin/env python3
+
+# benchmark.py
+#
+# Runs the benchmark workloads on every execution mode of the emulator
+# and reports the host speed in MIPS (millions of simulated instructions
+# per second of wall-clock time) and the simulated CPI. The results are
+# compared against a stored baseline, such that regressions are flagged.
+# The simulated results are deterministic and kept in the repository, the
+# MIPS depend on the host and are kept in a separate, local baseline.
+# Every workload is also co-simulated once per mode against the reference
+# model, such that a wrong result is caught even if the checksum matches.
+#
+# Copyright (C) 2021  Leiden University, The Netherlands
+#
+
+import os, sys
+from pathlib import Path
+import subprocess
+import json
+import re
+import statistics
+import time
+
+from argparse import ArgumentParser
+
+try:
+    from colorama import init, Fore, Style
+
+    enable_color = True
+except ImportError:
+    enable_color = False
+
+
+# Returns posix on POSIX platform, nt on NT/Windows
+def posix_nt(posix, nt):
+    return posix if os.name == "posix" else nt
+
+
+# Wrapper functions for optional color output
+def bright(s):
+    if enable_color:
+        s = Style.BRIGHT + s + Style.RESET_ALL
+    return s
+
+
+def passed(s):
+    if enable_color:
+        s = Fore.GREEN + s + Style.RESET_ALL
+    return s
+
+
+def failed(s):
+    if enable_color:
+        s = Fore.RED + s + Style.RESET_ALL
+    return s
+
+
+if enable_color:
+    init(autoreset=True)
+
+# Need emulator available
+RV64_EMU = Path(posix_nt("rv64-emu", "Windows\\rv64-emu.exe"))
+if not RV64_EMU.exists():
+    print(
+        "rv64-emu{} executable not available, compile it first.".format(
+            posix_nt("", ".exe")
+        ),
+        file=sys.stderr,
+    )
+    exit(1)
+RV64_EMU = RV64_EMU.resolve()
+
+# The execution modes and the options that select them
+MODES = {
+    "non-pipelined": [],
+    "pipelined": ["-p"],
+    "out-of-order": ["-o"],
+}
+
+STATS_RE = re.compile(r"(\d+) clock cycles, .* (\d+) instructions completed")
+CHECKSUM_RE = re.compile(r"checksum: (0x[0-9a-f]+)")
+DIVERGENCE_RE = re.compile(r"Co-simulation diverged at .*")
+
+# Number of instructions compared per co-simulation batch (-C)
+COSIM_BATCH = 64
+
+# Results of the simulation, and those that depend on the host
+SIMULATED_KEYS = ("checksum", "cpi", "cycles", "instructions")
+HOST_KEYS = ("mips", "stdev")
+
+
+# Parse arguments
+parser = ArgumentParser()
+parser.add_argument(
+    "-C",
+    dest="dir",
+    action="store",
+    type=str,
+    default=str(Path(__file__).parent.parent / "tests" / "benchmarks"),
+    help="Directory containing the benchmarks and the baseline",
+)
+parser.add_argument(
+    "-n",
+    dest="trials",
+    action="store",
+    type=int,
+    default=3,
+    help="Number of trials per workload and mode (default: 3)",
+)
+parser.add_argument(
+    "-m",
+    dest="modes",
+    action="append",
+    choices=MODES.keys(),
+    help="Only run the given mode, may be repeated",
+)
+parser.add_argument(
+    "-t",
+    dest="tolerance",
+    action="store",
+    type=float,
+    default=10.0,
+    help="Allowed drop of the MIPS in percent (default: 10)",
+)
+parser.add_argument(
+    "-b",
+    dest="baseline",
+    action="store",
+    type=str,
+    default="baseline.json",
+    help="Baseline file, relative to the benchmark directory",
+)
+parser.add_argument(
+    "-s",
+    dest="save",
+    action="store_true",
+    help="Store the results as the new baseline",
+)
+parser.add_argument(
+    "workload",
+    type=str,
+    nargs="*",
+    help="Optional names of the workloads to run",
+)
+args = parser.parse_args()
+
+benchdir = Path(args.dir)
+if not benchdir.exists() or not benchdir.is_dir():
+    print("Directory {} does not exist".format(args.dir), file=sys.stderr)
+    exit(1)
+
+if args.trials < 1:
+    print("Need at least one trial", file=sys.stderr)
+    exit(1)
+
+if args.workload:
+    workloads = [benchdir / (w + ".bin") for w in args.workload]
+    for w in workloads:
+        if not w.exists():
+            print("Workload {} does not exist".format(w), file=sys.stderr)
+            exit(1)
+else:
+    workloads = sorted(benchdir.glob("*.bin"))
+
+modes = args.modes if args.modes else list(MODES.keys())
+
+
+def load_baseline(path):
+    if not path.exists():
+        return {}
+    with path.open() as fh:
+        return json.load(fh)
+
+
+def save_baseline(path, data, results, keys):
+    """Merges the given keys of the results into a baseline file."""
+    for name, modes_results in results.items():
+        for mode, current in modes_results.items():
+            data.setdefault(name, {})[mode] = {k: current[k] for k in keys}
+    with path.open("w") as fh:
+        json.dump(data, fh, indent=2, sort_keys=True)
+        fh.write("\n")
+    print("Baseline written to {}".format(path))
+
+
+# The host baseline sits next to the baseline, e.g. baseline.host.json
+baseline_file = benchdir / args.baseline
+host_baseline_file = baseline_file.with_suffix(".host.json")
+baseline = load_baseline(baseline_file)
+host_baseline = load_baseline(host_baseline_file)
+
+
+def run_trial(workload, mode):
+    """Runs a workload once, returns the wall-clock time, the statistics
+    and the checksum printed by the program."""
+    start = time.perf_counter()
+    result = subprocess.run(
+        [str(RV64_EMU), *MODES[mode], "-s", "-", str(workload)],
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+    )
+    elapsed = time.perf_counter() - start
+
+    if result.returncode != 0:
+        raise RuntimeError("non-zero exit status: " + str(result.returncode))
+
+    stats = STATS_RE.search(result.stderr.decode())
+    if not stats:
+        raise RuntimeError("no statistics found in the output")
+
+    checksum = CHECKSUM_RE.search(result.stdout.decode())
+    return (
+        elapsed,
+        int(stats.group(1)),
+        int(stats.group(2)),
+        checksum.group(1) if checksum else None,
+    )
+
+
+def cosimulate(workload, mode):
+    """Runs a workload once in lock-step with the reference model, returns
+    None if it retired the same instructions or else the divergence."""
+    result = subprocess.run(
+        [str(RV64_EMU), *MODES[mode], "-C", str(COSIM_BATCH), str(workload)],
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+    )
+    if result.returncode == 0:
+        return None
+
+    divergence = DIVERGENCE_RE.search(result.stderr.decode())
+    if divergence:
+        return divergence.group(0)
+    return "co-simulation failed with exit status " + str(result.returncode)
+
+
+def compare(name, mode, current):
+    """Compares a result against the baseline, returns a list of the
+    regressions found."""
+    reference = baseline.get(name, {}).get(mode)
+    if not reference:
+        return []
+
+    problems = []
+    if current["checksum"] != reference["checksum"]:
+        problems.append(
+            "checksum {} differs from {}".format(
+                current["checksum"], reference["checksum"]
+            )
+        )
+    if current["cpi"] > reference["cpi"] * 1.0001:
+        problems.append(
+            "CPI increased from {:.4f} to {:.4f}".format(
+                reference["cpi"], current["cpi"]
+            )
+        )
+    return problems
+
+
+def compare_host(name, mode, current):
+    """Compares the MIPS against the baseline recorded on this host."""
+    reference = host_baseline.get(name, {}).get(mode)
+    if not reference:
+        return []
+
+    limit = reference["mips"] * (1.0 - args.tolerance / 100.0)
+    if current["mips"] < limit:
+        return [
+            "MIPS dropped from {:.2f} to {:.2f}".format(
+                reference["mips"], current["mips"]
+            )
+        ]
+    return []
+
+
+print(
+    bright(
+        "{} workloads, {} modes, {} trials".format(
+            len(workloads), len(modes), args.trials
+        )
+    )
+)
+print()
+print(
+    "{:<12} {:<14} {:>12} {:>8} {:>16} {:>6}".format(
+        "workload", "mode", "instructions", "CPI", "MIPS", "CV"
+    )
+)
+
+results = {}
+regressions = []
+
+for workload in workloads:
+    name = workload.stem
+    for mode in modes:
+        try:
+            trials = [run_trial(workload, mode) for _ in range(args.trials)]
+        except RuntimeError as e:
+            print(failed("{:<12} {:<14} error: {}".format(name, mode, e)))
+            regressions.append("{} ({}): {}".format(name, mode, e))
+            continue
+
+        # The simulation is deterministic, only the host time varies
+        _, cycles, instructions, checksum = trials[0]
+        mips = [instructions / t[0] / 1e6 for t in trials]
+        mean = statistics.mean(mips)
+        stdev = statistics.stdev(mips) if len(mips) > 1 else 0.0
+
+        current = {
+            "cycles": cycles,
+            "instructions": instructions,
+            "cpi": cycles / instructions,
+            "mips": mean,
+            "stdev": stdev,
+            "checksum": checksum,
+        }
+        results.setdefault(name, {})[mode] = current
+
+        line = "{:<12} {:<14} {:>12} {:>8.4f} {:>8.2f} ± {:<5.2f} {:>5.1f}%".format(
+            name,
+            mode,
+            instructions,
+            current["cpi"],
+            mean,
+            stdev,
+            100.0 * stdev / mean,
+        )
+
+        problems = compare(name, mode, current) + compare_host(name, mode, current)
+        divergence = cosimulate(workload, mode)
+        if divergence:
+            problems.append(divergence)
+        if problems:
+            print(failed(line))
+            for p in problems:
+                print(failed("    " + p))
+                regressions.append("{} ({}): {}".format(name, mode, p))
+        else:
+            print(line)
+
+print()
+
+if args.save:
+    save_baseline(baseline_file, baseline, results, SIMULATED_KEYS)
+    save_baseline(host_baseline_file, host_baseline, results, HOST_KEYS)
+    print()
+
+if not baseline and not host_baseline:
+    banner = " no baseline, nothing compared "
+    status = 0
+    print(bright("=" * 20 + banner + "=" * 20))
+elif regressions:
+    banner = " {} regressions ".format(len(regressions))
+    print(failed("=" * 20 + banner + "=" * 20))
+    status = 1
+else:
+    banner = " no regressions "
+    print(passed("=" * 20 + banner + "=" * 20))
+    status = 0
+
+exit(status)
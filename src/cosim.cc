@@ -0,0 +1,540 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    cosim.cc - Differential co-simulation against a reference ISA model.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "cosim.h"
+
+#include "elf-file.h"
+#include "inst-decoder.h"
+#include "memory.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+/*
+ * ReferenceModel
+ */
+
+static int64_t
+signExtend(uint64_t value, unsigned bits)
+{
+  const unsigned shift = 64 - bits;
+  return static_cast<int64_t>(value << shift) >> shift;
+}
+
+ReferenceModel::ReferenceModel(const ELFFile& program)
+    : memories{program.createMemories()}
+{
+}
+
+void
+ReferenceModel::addRAM(MemAddress base, size_t size)
+{
+  auto memory = Memory::createZeroed("ram", base, size);
+  memory->setMayWrite(true);
+  memories.push_back(std::move(memory));
+}
+
+void
+ReferenceModel::setRegister(RegNumber regnum, RegValue value)
+{
+  if (regnum != 0 && regnum < NumRegs)
+    regs[regnum] = value;
+}
+
+void
+ReferenceModel::recordWrite(uint64_t index, MemAddress addr,
+                            const std::byte* data, size_t size)
+{
+  pendingWrites.push_back({index, addr, {data, data + size}});
+
+  /* The initial stack is written before the first instruction */
+  if (index == 0)
+    applySyscallWrites(0);
+}
+
+void
+ReferenceModel::applySyscallWrites(uint64_t index)
+{
+  while (!pendingWrites.empty() && pendingWrites.front().index == index) {
+    const PendingWrite& write = pendingWrites.front();
+    for (size_t i = 0; i < write.data.size(); ++i)
+      store(write.addr + i, 1, static_cast<uint8_t>(write.data[i]));
+    pendingWrites.pop_front();
+  }
+}
+
+MemoryInterface*
+ReferenceModel::findMemory(MemAddress addr) const
+{
+  for (auto& memory : memories)
+    if (memory->contains(addr))
+      return memory.get();
+
+  return nullptr;
+}
+
+RegValue
+ReferenceModel::load(MemAddress addr, uint8_t size,
+                     const TraceRecord& observed)
+{
+  MemoryInterface* memory = findMemory(addr);
+  if (!memory) {
+    /* Device registers cannot be modeled, use what the core read. */
+    if (observed.access != TraceRecord::Access::Load ||
+        observed.address != addr)
+      throw IllegalAccess(addr, size);
+    return observed.data;
+  }
+
+  switch (size) {
+  case 1:
+    return memory->readByte(addr);
+  case 2:
+    return memory->readHalfWord(addr);
+  case 4:
+    return memory->readWord(addr);
+  default:
+    return memory->readDoubleWord(addr);
+  }
+}
+
+void
+ReferenceModel::store(MemAddress addr, uint8_t size, RegValue value)
+{
+  MemoryInterface* memory = findMemory(addr);
+  if (!memory)
+    return;
+
+  switch (size) {
+  case 1:
+    memory->writeByte(addr, value);
+    break;
+  case 2:
+    memory->writeHalfWord(addr, value);
+    break;
+  case 4:
+    memory->writeWord(addr, value);
+    break;
+  default:
+    memory->writeDoubleWord(addr, value);
+    break;
+  }
+}
+
+void
+ReferenceModel::step(const TraceRecord& observed, TraceRecord& record)
+{
+  MemoryInterface* text = findMemory(PC);
+  if (!text)
+    throw IllegalAccess(PC, 4);
+
+  const uint32_t word = text->readWord(PC);
+  const unsigned opcode = word & 0x7f;
+  RegNumber rd = (word >> 7) & 0x1f;
+  const unsigned funct3 = (word >> 12) & 0x7;
+  const RegValue a = regs[(word >> 15) & 0x1f];
+  const RegValue b = regs[(word >> 20) & 0x1f];
+  const unsigned funct7 = word >> 25;
+
+  const int64_t immI = signExtend(word >> 20, 12);
+  const int64_t immS =
+      signExtend(((word >> 25) << 5) | ((word >> 7) & 0x1f), 12);
+  const int64_t immB =
+      signExtend(((word >> 31) << 12) | (((word >> 7) & 0x1) << 11) |
+                     (((word >> 25) & 0x3f) << 5) | (((word >> 8) & 0xf) << 1),
+                 13);
+  const int64_t immU = signExtend(word & 0xfffff000, 32);
+  const int64_t immJ =
+      signExtend(((word >> 31) << 20) | (((word >> 12) & 0xff) << 12) |
+                     (((word >> 20) & 0x1) << 11) |
+                     (((word >> 21) & 0x3ff) << 1),
+                 21);
+
+  record = TraceRecord{};
+  record.PC = PC;
+  record.instructionWord = word;
+
+  MemAddress nextPC = PC + 4;
+  bool writesRD = true;
+  RegValue result = 0;
+
+  auto illegal = [&]() {
+    std::stringstream ss;
+    ss << "reference model cannot execute 0x" << std::hex << std::setw(8)
+       << std::setfill('0') << word << " at 0x" << PC;
+    throw CoSimDivergence(ss.str());
+  };
+
+  switch (opcode) {
+  case 0x37: /* LUI */
+    result = immU;
+    break;
+
+  case 0x17: /* AUIPC */
+    result = PC + immU;
+    break;
+
+  case 0x6f: /* JAL */
+    result = PC + 4;
+    nextPC = PC + immJ;
+    break;
+
+  case 0x67: /* JALR */
+    result = PC + 4;
+    nextPC = (a + immI) & ~RegValue{1};
+    break;
+
+  case 0x63: { /* BRANCH */
+    bool taken = false;
+    switch (funct3) {
+    case 0x0:
+      taken = a == b;
+      break;
+    case 0x1:
+      taken = a != b;
+      break;
+    case 0x4:
+      taken = static_cast<int64_t>(a) < static_cast<int64_t>(b);
+      break;
+    case 0x5:
+      taken = static_cast<int64_t>(a) >= static_cast<int64_t>(b);
+      break;
+    case 0x6:
+      taken = a < b;
+      break;
+    case 0x7:
+      taken = a >= b;
+      break;
+    default:
+      illegal();
+    }
+    if (taken)
+      nextPC = PC + immB;
+    writesRD = false;
+    break;
+  }
+
+  case 0x03: { /* LOAD */
+    if (funct3 == 0x7)
+      illegal();
+    const uint8_t size = 1 << (funct3 & 0x3);
+    const MemAddress addr = a + immI;
+    const RegValue value = load(addr, size, observed);
+
+    record.access = TraceRecord::Access::Load;
+    record.size = size;
+    record.address = addr;
+    record.data = value;
+
+    if (funct3 & 0x4 || size == 8)
+      result = value;
+    else
+      result = signExtend(value, 8 * size);
+    break;
+  }
+
+  case 0x23: { /* STORE */
+    if (funct3 > 0x3)
+      illegal();
+    const uint8_t size = 1 << funct3;
+    const MemAddress addr = a + immS;
+    store(addr, size, b);
+
+    record.access = TraceRecord::Access::Store;
+    record.size = size;
+    record.address = addr;
+    record.data = b;
+    writesRD = false;
+    break;
+  }
+
+  case 0x13: { /* OP-IMM */
+    const unsigned shamt = (word >> 20) & 0x3f;
+    switch (funct3) {
+    case 0x0:
+      result = a + immI;
+      break;
+    case 0x2:
+      result = static_cast<int64_t>(a) < immI;
+      break;
+    case 0x3:
+      result = a < static_cast<RegValue>(immI);
+      break;
+    case 0x4:
+      result = a ^ immI;
+      break;
+    case 0x6:
+      result = a | immI;
+      break;
+    case 0x7:
+      result = a & immI;
+      break;
+    case 0x1:
+      result = a << shamt;
+      break;
+    case 0x5:
+      if (funct7 & 0x20)
+        result = static_cast<int64_t>(a) >> shamt;
+      else
+        result = a >> shamt;
+      break;
+    }
+    break;
+  }
+
+  case 0x33: /* OP */
+    switch (funct3 | (funct7 << 3)) {
+    case 0x000:
+      result = a + b;
+      break;
+    case 0x100:
+      result = a - b;
+      break;
+    case 0x001:
+      result = a << (b & 0x3f);
+      break;
+    case 0x002:
+      result = static_cast<int64_t>(a) < static_cast<int64_t>(b);
+      break;
+    case 0x003:
+      result = a < b;
+      break;
+    case 0x004:
+      result = a ^ b;
+      break;
+    case 0x005:
+      result = a >> (b & 0x3f);
+      break;
+    case 0x105:
+      result = static_cast<int64_t>(a) >> (b & 0x3f);
+      break;
+    case 0x006:
+      result = a | b;
+      break;
+    case 0x007:
+      result = a & b;
+      break;
+    default:
+      illegal();
+    }
+    break;
+
+  case 0x1b: { /* OP-IMM-32 */
+    const unsigned shamt = (word >> 20) & 0x1f;
+    const uint32_t a32 = a;
+    if (funct3 == 0x0)
+      result = signExtend(a32 + static_cast<uint32_t>(immI), 32);
+    else if (funct3 == 0x1)
+      result = signExtend(a32 << shamt, 32);
+    else if (funct3 == 0x5 && funct7 == 0x20)
+      result = static_cast<int32_t>(a32) >> shamt;
+    else if (funct3 == 0x5)
+      result = signExtend(a32 >> shamt, 32);
+    else
+      illegal();
+    break;
+  }
+
+  case 0x3b: { /* OP-32 */
+    const uint32_t a32 = a;
+    const uint32_t b32 = b;
+    switch (funct3 | (funct7 << 3)) {
+    case 0x000:
+      result = signExtend(a32 + b32, 32);
+      break;
+    case 0x100:
+      result = signExtend(a32 - b32, 32);
+      break;
+    case 0x001:
+      result = signExtend(a32 << (b32 & 0x1f), 32);
+      break;
+    case 0x005:
+      result = signExtend(a32 >> (b32 & 0x1f), 32);
+      break;
+    case 0x105:
+      result = static_cast<int32_t>(a32) >> (b32 & 0x1f);
+      break;
+    default:
+      illegal();
+    }
+    break;
+  }
+
+  case 0x73: /* SYSTEM */
+    /* ecall: replay the memory written by the system call and take the
+     * result from a0.
+     */
+    if (word == 0x00000073) {
+      if (observed.PC != PC || observed.instructionWord != word)
+        illegal();
+      applySyscallWrites(++nSyscalls);
+      rd = 10;
+      result = observed.rdValue;
+      break;
+    }
+
+    if (funct3 == 0x0 || funct3 == 0x4) {
+      writesRD = false;
+      break;
+    }
+
+    /* The counter CSRs depend on timing, use what the core read. */
+    if (observed.PC != PC || observed.instructionWord != word)
+      illegal();
+    result = observed.rdValue;
+    break;
+
+  case 0x0f: /* FENCE */
+    writesRD = false;
+    break;
+
+  default:
+    illegal();
+  }
+
+  if (writesRD && rd != 0) {
+    regs[rd] = result;
+    record.writesRD = true;
+    record.rd = rd;
+    record.rdValue = result;
+  }
+
+  PC = nextPC;
+}
+
+/*
+ * CoSimulator
+ */
+
+/* Stored data is compared at the access size, like the trace does. */
+static RegValue
+storedData(const TraceRecord& record)
+{
+  if (record.access != TraceRecord::Access::Store)
+    return 0;
+  if (record.size >= sizeof(RegValue))
+    return record.data;
+  return record.data & ((RegValue{1} << (8 * record.size)) - 1);
+}
+
+static bool
+sameRetirement(const TraceRecord& a, const TraceRecord& b)
+{
+  return a.PC == b.PC && a.instructionWord == b.instructionWord &&
+         a.writesRD == b.writesRD && a.rd == b.rd &&
+         a.rdValue == b.rdValue && a.access == b.access &&
+         a.address == b.address && storedData(a) == storedData(b);
+}
+
+static std::string
+formatRecord(const TraceRecord& record)
+{
+  std::stringstream ss;
+  ss << std::hex << "PC 0x" << record.PC << "  0x" << std::setw(8)
+     << std::setfill('0') << record.instructionWord << std::setfill(' ')
+     << "  ";
+
+  InstructionDecoder decoder;
+  decoder.setInstructionWord(record.instructionWord);
+  try {
+    ss << decoder;
+  } catch (IllegalInstruction&) {
+    ss << "illegal instruction";
+  }
+
+  if (record.writesRD)
+    ss << "  r" << std::dec << static_cast<int>(record.rd) << std::hex
+       << " = 0x" << record.rdValue;
+  if (record.access == TraceRecord::Access::Load)
+    ss << "  load [0x" << record.address << "]";
+  else if (record.access == TraceRecord::Access::Store)
+    ss << "  store [0x" << record.address << "] 0x" << storedData(record);
+
+  return ss.str();
+}
+
+CoSimulator::CoSimulator(const ELFFile& program, size_t batchSize)
+    : reference{program}, batchSize{std::max<size_t>(batchSize, 1)}
+{
+  batch.reserve(this->batchSize);
+  expected.reserve(this->batchSize);
+}
+
+void
+CoSimulator::start(MemAddress PC, const std::array<RegValue, NumRegs>& regs)
+{
+  reference.setPC(PC);
+  for (RegNumber i = 0; i < NumRegs; ++i)
+    reference.setRegister(i, regs[i]);
+}
+
+uint64_t
+CoSimulator::hashRecord(uint64_t hash, const TraceRecord& record)
+{
+  auto mix = [&hash](uint64_t value) {
+    hash = (hash ^ value) * 0x9e3779b97f4a7c15;
+    hash ^= hash >> 32;
+  };
+
+  mix(record.PC ^ (static_cast<uint64_t>(record.instructionWord) << 32));
+  if (record.writesRD)
+    mix(record.rdValue + record.rd);
+  if (record.access != TraceRecord::Access::None)
+    mix(record.address ^ (static_cast<uint64_t>(record.access) << 62));
+  if (record.access == TraceRecord::Access::Store)
+    mix(storedData(record));
+
+  return hash;
+}
+
+void
+CoSimulator::check()
+{
+  uint64_t referenceHash = 0;
+  TraceRecord record;
+
+  expected.clear();
+  try {
+    for (const auto& observed : batch) {
+      reference.step(observed, record);
+      expected.push_back(record);
+      referenceHash = hashRecord(referenceHash, record);
+    }
+  } catch (std::exception& e) {
+    /* The reference model failed within the batch; report the first
+     * divergence before that point or the failure itself.
+     */
+    reportDivergence(e.what());
+  }
+
+  if (referenceHash != hash)
+    reportDivergence();
+
+  nChecked += batch.size();
+  batch.clear();
+  hash = 0;
+}
+
+void
+CoSimulator::reportDivergence(const char* reason)
+{
+  size_t i = 0;
+  while (i < expected.size() && sameRetirement(batch[i], expected[i]))
+    ++i;
+
+  std::stringstream ss;
+  ss << "Co-simulation diverged at retired instruction " << std::dec
+     << nChecked + i + 1 << std::endl;
+  ss << "  core:      " << formatRecord(batch[i]) << std::endl;
+  if (i < expected.size())
+    ss << "  reference: " << formatRecord(expected[i]);
+  else
+    ss << "  reference: " << reason;
+
+  throw CoSimDivergence(ss.str());
+}
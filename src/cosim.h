@@ -0,0 +1,139 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    cosim.h - Differential co-simulation against a reference ISA model.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __COSIM_H__
+#define __COSIM_H__
+
+#include "arch.h"
+#include "memory-interface.h"
+#include "trace.h"
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ELFFile;
+
+/* Reported when the core and the reference model disagree. */
+class CoSimDivergence : public std::exception {
+public:
+  explicit CoSimDivergence(const std::string& message) : message{message} {}
+
+  const char* what() const noexcept override { return message.c_str(); }
+
+private:
+  std::string message{};
+};
+
+/* Functional model of the RV64I instructions supported by the cores,
+ * written independently of the ALU, the control signals and the memory
+ * bus. It executes one instruction per step, on its own copy of the
+ * program's memories. Accesses outside of these memories go to devices;
+ * stores to devices are dropped and loads from devices return the value
+ * that was observed by the core, as do CSR reads. Likewise, system calls
+ * are not executed but return the result observed by the core, and the
+ * memory written by the n-th system call is applied when the model
+ * executes it.
+ */
+class ReferenceModel {
+public:
+  ReferenceModel(const ELFFile& program);
+
+  void addRAM(MemAddress base, size_t size);
+
+  void setPC(MemAddress PC) { this->PC = PC; }
+  void setRegister(RegNumber regnum, RegValue value);
+
+  /* Memory written by system call index, counting from one; zero
+   * writes the initial memory contents.
+   */
+  void recordWrite(uint64_t index, MemAddress addr, const std::byte* data,
+                   size_t size);
+
+  /* Execute a single instruction and describe it in record. */
+  void step(const TraceRecord& observed, TraceRecord& record);
+
+private:
+  struct PendingWrite {
+    uint64_t index{};
+    MemAddress addr{};
+    std::vector<std::byte> data{};
+  };
+
+  MemAddress PC{};
+  std::array<RegValue, NumRegs> regs{};
+  std::vector<std::unique_ptr<MemoryInterface>> memories;
+
+  std::deque<PendingWrite> pendingWrites{};
+  uint64_t nSyscalls{};
+
+  void applySyscallWrites(uint64_t index);
+
+  MemoryInterface* findMemory(MemAddress addr) const;
+  RegValue load(MemAddress addr, uint8_t size, const TraceRecord& observed);
+  void store(MemAddress addr, uint8_t size, RegValue value);
+};
+
+/* Compares the instructions retired by a core with the reference model.
+ * To keep the overhead low, the retired PC, destination register and
+ * value and the store address and data are folded into a hash. Every
+ * batchSize instructions, the reference model executes the same number
+ * of instructions and the hashes are compared. Only on a mismatch are
+ * the instructions of the batch compared one by one, to report the
+ * first one that diverged. A batch size of 1 checks every instruction
+ * as soon as it retires.
+ */
+class CoSimulator {
+public:
+  CoSimulator(const ELFFile& program, size_t batchSize);
+
+  void addRAM(MemAddress base, size_t size) { reference.addRAM(base, size); }
+
+  void recordWrite(uint64_t index, MemAddress addr, const std::byte* data,
+                   size_t size)
+  {
+    reference.recordWrite(index, addr, data, size);
+  }
+
+  /* Set the architectural state from which both models start. */
+  void start(MemAddress PC, const std::array<RegValue, NumRegs>& regs);
+
+  void retire(const TraceRecord& record)
+  {
+    batch.push_back(record);
+    hash = hashRecord(hash, record);
+    if (batch.size() == batchSize)
+      check();
+  }
+
+  /* Check the instructions retired since the last check. */
+  void finish()
+  {
+    if (!batch.empty())
+      check();
+  }
+
+  uint64_t getInstrChecked() const { return nChecked; }
+
+private:
+  ReferenceModel reference;
+  const size_t batchSize;
+
+  std::vector<TraceRecord> batch{};
+  std::vector<TraceRecord> expected{};
+  uint64_t hash{};
+  uint64_t nChecked{};
+
+  static uint64_t hashRecord(uint64_t hash, const TraceRecord& record);
+
+  void check();
+  [[noreturn]] void reportDivergence(const char* reason = nullptr);
+};
+
+#endif /* __COSIM_H__ */
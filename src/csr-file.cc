@@ -0,0 +1,101 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    csr-file.cc - Control and status registers (Zicsr).
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "csr-file.h"
+
+#include "inst-decoder.h"
+
+CSRFile::CSRFile()
+{
+  /* mcycle, time and minstret count fixed events */
+  counters[0].event = static_cast<uint8_t>(PerfCounter::Cycles) + 1;
+  counters[1].event = static_cast<uint8_t>(PerfCounter::Cycles) + 1;
+  counters[2].event = static_cast<uint8_t>(PerfCounter::InstrCompleted) + 1;
+}
+
+void
+CSRFile::setCounterSource(PerfCounterSource source)
+{
+  counterSource = std::move(source);
+}
+
+RegValue
+CSRFile::read(uint16_t csr) const
+{
+  if (csr >= Cycle && csr < Cycle + NumCounters)
+    return readCounter(csr - Cycle);
+  if (csr >= MCycle && csr < MCycle + NumCounters && csr != MCycle + 1)
+    return readCounter(csr - MCycle);
+  if (csr >= MHPMEvent3 && csr < MHPMEvent3 + NumCounters - 3)
+    return counters[csr - MHPMEvent3 + 3].event;
+
+  throw IllegalInstruction("Unknown CSR");
+}
+
+void
+CSRFile::write(uint16_t csr, RegValue value)
+{
+  if (csr >= MCycle && csr < MCycle + NumCounters && csr != MCycle + 1)
+    writeCounter(csr - MCycle, value);
+  else if (csr >= MHPMEvent3 && csr < MHPMEvent3 + NumCounters - 3) {
+    /* The counter keeps its value when switching events */
+    const size_t index = csr - MHPMEvent3 + 3;
+    const RegValue current = readCounter(index);
+    counters[index].event = value <= NumPerfCounters ? value : 0;
+    writeCounter(index, current);
+  } else if (csr >= Cycle && csr < Cycle + NumCounters)
+    throw IllegalInstruction("Write to read-only CSR");
+  else
+    throw IllegalInstruction("Unknown CSR");
+}
+
+bool
+CSRFile::writesCSR(uint8_t funct3, RegNumber rs1)
+{
+  return (funct3 & 0x3) == 0x1 || rs1 != 0;
+}
+
+RegValue
+CSRFile::applyOperation(uint8_t funct3, RegValue old, RegValue operand)
+{
+  switch (funct3 & 0x3) {
+  case 0x1: /* CSRRW */
+    return operand;
+  case 0x2: /* CSRRS */
+    return old | operand;
+  case 0x3: /* CSRRC */
+    return old & ~operand;
+  default:
+    throw IllegalInstruction("Unknown CSR instruction");
+  }
+}
+
+/*
+ * Private methods
+ */
+
+RegValue
+CSRFile::readEvent(uint8_t event) const
+{
+  if (event == 0 || !counterSource)
+    return 0;
+  return counterSource(static_cast<PerfCounter>(event - 1));
+}
+
+RegValue
+CSRFile::readCounter(size_t index) const
+{
+  const Counter& counter = counters[index];
+  return counter.offset + readEvent(counter.event);
+}
+
+void
+CSRFile::writeCounter(size_t index, RegValue value)
+{
+  Counter& counter = counters[index];
+  counter.offset = value - readEvent(counter.event);
+}
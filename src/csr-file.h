@@ -0,0 +1,75 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    csr-file.h - Control and status registers (Zicsr).
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __CSR_FILE_H__
+#define __CSR_FILE_H__
+
+#include "arch.h"
+#include "perf-counter.h"
+
+#include <array>
+
+/* The counter CSRs of the processor. The unprivileged cycle, time,
+ * instret and hpmcounter3-31 CSRs are read-only views of the machine
+ * counters mcycle, minstret and mhpmcounter3-31, which can be written.
+ * There is no real-time clock, time counts clock cycles like cycle.
+ *
+ * Each mhpmcounter counts the event selected by the corresponding
+ * mhpmevent CSR: zero counts nothing, otherwise the event is the
+ * performance counter with index mhpmevent - 1. Unsupported events read
+ * back as zero. Counters are derived from the processor's counters on
+ * every read, so they cost nothing while they are not read.
+ */
+class CSRFile {
+public:
+  static constexpr uint16_t Cycle = 0xC00;
+  static constexpr uint16_t Time = 0xC01;
+  static constexpr uint16_t InstRet = 0xC02;
+  static constexpr uint16_t HPMCounter3 = 0xC03;
+  static constexpr uint16_t MCycle = 0xB00;
+  static constexpr uint16_t MInstRet = 0xB02;
+  static constexpr uint16_t MHPMCounter3 = 0xB03;
+  static constexpr uint16_t MHPMEvent3 = 0x323;
+
+  CSRFile();
+
+  void setCounterSource(PerfCounterSource source);
+
+  /* Both throw IllegalInstruction for CSRs that do not exist, writing
+   * also for read-only CSRs.
+   */
+  RegValue read(uint16_t csr) const;
+  void write(uint16_t csr, RegValue value);
+
+  /* CSRRS and CSRRC, and their immediate forms, do not write the CSR
+   * when the rs1 field is zero.
+   */
+  static bool writesCSR(uint8_t funct3, RegNumber rs1);
+
+  /* The value written by the Zicsr instruction funct3, given the old
+   * value of the CSR and the value of rs1 or the immediate.
+   */
+  static RegValue applyOperation(uint8_t funct3, RegValue old,
+                                 RegValue operand);
+
+private:
+  static constexpr size_t NumCounters = 32;
+
+  struct Counter {
+    uint8_t event{};
+    RegValue offset{};
+  };
+
+  std::array<Counter, NumCounters> counters{};
+  PerfCounterSource counterSource{};
+
+  RegValue readEvent(uint8_t event) const;
+  RegValue readCounter(size_t index) const;
+  void writeCounter(size_t index, RegValue value);
+};
+
+#endif /* __CSR_FILE_H__ */
@@ -31,6 +31,7 @@
 #endif
 
 #include <algorithm>
+#include <cstring>
 #include <filesystem>
 namespace fs = std::filesystem;
 
@@ -128,6 +129,100 @@ ELFFile::unload()
   fd = decltype(fd){};
 }
 
+size_t
+ELFFile::getMappingGranularity() const
+{
+#ifdef _MSC_VER
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwAllocationGranularity;
+#else
+  return sysconf(_SC_PAGESIZE);
+#endif
+}
+
+/* Segments are mapped straight from the file instead of being copied.
+ * The mapping is private: read-only segments share the pages of the
+ * file in the host's page cache between all simulations of the same
+ * program, and written pages of writable segments are copied on write.
+ * As mappings must start at a page boundary, a segment's mapping also
+ * covers the preceding part of the file within its first page, the
+ * Memory only permits access to the segment itself.
+ *
+ * The part of the segment beyond fileSize reads as zero. On POSIX
+ * systems the file is mapped over an anonymous mapping of the complete
+ * segment, after which the remainder of the last file page is cleared.
+ * Windows cannot place a file view over an existing allocation, so
+ * there such segments are copied into zeroed memory instead.
+ */
+std::unique_ptr<Memory>
+ELFFile::mapSegment(const std::string& name, uint64_t offset, MemAddress base,
+                    size_t fileSize, size_t memSize, bool writable) const
+{
+#ifndef _MSC_VER
+  if (offset > programSize || fileSize > programSize - offset)
+    throw std::runtime_error("Segment " + name + " exceeds the file size.");
+#endif
+
+  const size_t granularity = getMappingGranularity();
+  const uint64_t mappingOffset = offset & ~(granularity - 1);
+  const size_t delta = offset - mappingOffset;
+
+#ifdef _MSC_VER
+  if (memSize > fileSize) {
+    auto memory = Memory::createZeroed(name, base, memSize);
+    memory->initialize(base,
+                       static_cast<const std::byte*>(mapAddr) + offset,
+                       fileSize);
+    return memory;
+  }
+
+  const size_t mappingSize = delta + fileSize;
+  void* mapping = MapViewOfFile(
+      this->mapping, writable ? FILE_MAP_COPY : FILE_MAP_READ,
+      static_cast<DWORD>(mappingOffset >> 32),
+      static_cast<DWORD>(mappingOffset), mappingSize);
+  if (!mapping)
+    throw std::runtime_error("Failed to map segment " + name + ".");
+#else
+  const size_t mappingSize = delta + memSize;
+  const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+
+  void* mapping = MAP_FAILED;
+  if (memSize == fileSize)
+    mapping =
+        mmap(nullptr, mappingSize, prot, MAP_PRIVATE, fd, mappingOffset);
+  else {
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping != MAP_FAILED && fileSize > 0) {
+      void* fileMapping =
+          mmap(mapping, delta + fileSize, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_FIXED, fd, mappingOffset);
+      if (fileMapping == MAP_FAILED) {
+        munmap(mapping, mappingSize);
+        mapping = MAP_FAILED;
+      } else {
+        /* Clear the rest of the page that follows the file data */
+        const size_t fileEnd = delta + fileSize;
+        const size_t pageEnd =
+            std::min((fileEnd + granularity - 1) & ~(granularity - 1),
+                     mappingSize);
+        std::memset(static_cast<std::byte*>(mapping) + fileEnd, 0,
+                    pageEnd - fileEnd);
+      }
+    }
+    if (mapping != MAP_FAILED && !writable)
+      mprotect(mapping, mappingSize, prot);
+  }
+  if (mapping == MAP_FAILED)
+    throw std::runtime_error("Failed to map segment " + name + ".");
+#endif
+
+  return Memory::createFromFileMapping(name, mapping, mappingSize, delta, base,
+                                      memSize);
+}
+
 bool
 ELFFile::isELF() const
 {
@@ -187,45 +282,84 @@ foreachSegment(void* mapAddr, ForeachSegmentFunction func)
   }
 }
 
+/* A loadable segment, merged with adjacent segments where possible. */
+struct LoadSegment {
+  uint64_t offset;
+  MemAddress base;
+  size_t fileSize;
+  size_t memSize;
+  uint32_t flags;
+};
+
+/* Collect the PT_LOAD segments in address order. Segments that directly
+ * follow each other in both the address space and the file, and have
+ * the same permissions, are merged so that they need only a single bus
+ * client.
+ */
+static std::vector<LoadSegment>
+getLoadSegments(void* mapAddr)
+{
+  const auto* elf = static_cast<Elf64_Ehdr*>(mapAddr);
+
+  const auto* pheaders = reinterpret_cast<Elf64_Phdr*>(
+      reinterpret_cast<uintptr_t>(elf) + elf->e_phoff);
+
+  std::vector<LoadSegment> segments;
+  for (int i = 0; i < elf->e_phnum; ++i) {
+    const Elf64_Phdr& header = pheaders[i];
+    if (header.p_type == PT_LOAD && header.p_memsz > 0)
+      segments.push_back(LoadSegment{header.p_offset, header.p_vaddr,
+                                     header.p_filesz, header.p_memsz,
+                                     header.p_flags & (PF_R | PF_W | PF_X)});
+  }
+
+  std::sort(segments.begin(), segments.end(),
+            [](const LoadSegment& a, const LoadSegment& b) {
+              return a.base < b.base;
+            });
+
+  std::vector<LoadSegment> merged;
+  for (const auto& segment : segments) {
+    if (!merged.empty()) {
+      LoadSegment& last = merged.back();
+      if (last.flags == segment.flags &&
+          last.base + last.memSize == segment.base &&
+          (segment.fileSize == 0 ||
+           (last.fileSize == last.memSize &&
+            last.offset + last.fileSize == segment.offset))) {
+        if (segment.fileSize > 0)
+          last.fileSize += segment.fileSize;
+        last.memSize += segment.memSize;
+        continue;
+      }
+    }
+    merged.push_back(segment);
+  }
+
+  return merged;
+}
+
 std::vector<std::unique_ptr<MemoryInterface>>
 ELFFile::createMemories() const
 {
   std::vector<std::unique_ptr<MemoryInterface>> memories;
 
-  foreachSegment(
-      mapAddr,
-      [&memories](const Elf64_Ehdr* elf, const Elf64_Shdr& header) -> void {
-        size_t align = header.sh_addralign;
-
-        auto* segment = new (std::align_val_t{align}, std::nothrow)
-            std::byte[header.sh_size];
-        if (!segment)
-          throw std::runtime_error("Could not allocate aligned memory.");
-
-        if (reinterpret_cast<uintptr_t>(segment) & ((align - 1) != 0))
-          throw std::runtime_error(
-              "Allocated pointer for segment is not aligned.");
-
-        /* Transfer section data or clear the section. */
-        if (header.sh_type == SHT_PROGBITS) {
-          const auto* segdata =
-              reinterpret_cast<const std::byte*>(elf) + header.sh_offset;
-          std::copy_n(segdata, header.sh_size, segment);
-        } else
-          std::fill_n(segment, header.sh_size, std::byte{0});
-
-        /* FIXME: determine correct name for segment. */
-        std::string name{"data"};
-        if ((header.sh_flags & SHF_EXECINSTR) == SHF_EXECINSTR)
-          name = "text";
-
-        auto memory = std::make_unique<Memory>(name, segment, header.sh_addr,
-                                               header.sh_size, align);
-        if ((header.sh_flags & SHF_WRITE) == SHF_WRITE)
-          memory->setMayWrite(true);
-
-        memories.push_back(std::move(memory));
-      });
+  for (const auto& segment : getLoadSegments(mapAddr)) {
+    const bool writable = (segment.flags & PF_W) == PF_W;
+    const bool executable = (segment.flags & PF_X) == PF_X;
+    const std::string name{executable ? "text" : "data"};
+
+    std::unique_ptr<Memory> memory;
+    if (segment.fileSize == 0)
+      memory = Memory::createZeroed(name, segment.base, segment.memSize);
+    else
+      memory = mapSegment(name, segment.offset, segment.base,
+                          segment.fileSize, segment.memSize, writable);
+
+    memory->setMayWrite(writable);
+    memory->setMayExecute(executable);
+    memories.push_back(std::move(memory));
+  }
 
   return memories;
 }
@@ -256,6 +390,23 @@ ELFFile::getTextSegment(std::vector<std::byte>& segmentData,
                    found = true;
                  });
 
+  /* Binaries without section headers, use the executable segment. */
+  if (!found) {
+    for (const auto& segment : getLoadSegments(mapAddr)) {
+      if ((segment.flags & PF_X) != PF_X)
+        continue;
+
+      segmentData.assign(segment.memSize, std::byte{0});
+      const auto* segdata =
+          static_cast<const std::byte*>(mapAddr) + segment.offset;
+      std::copy_n(segdata, segment.fileSize, segmentData.begin());
+
+      segmentBase = segment.base;
+      segmentSize = segment.memSize;
+      return true;
+    }
+  }
+
   return found;
 }
 
@@ -264,3 +415,62 @@ ELFFile::getEntrypoint() const
 {
   return static_cast<Elf64_Ehdr*>(mapAddr)->e_entry;
 }
+
+SymbolTable
+ELFFile::getSymbolTable() const
+{
+  const auto* elf = static_cast<const Elf64_Ehdr*>(mapAddr);
+  const auto* base = reinterpret_cast<const char*>(elf);
+  const auto* sheaders =
+      reinterpret_cast<const Elf64_Shdr*>(base + elf->e_shoff);
+
+  std::vector<Symbol> symbols;
+
+  for (int i = 0; i < elf->e_shnum; ++i) {
+    const Elf64_Shdr& header = sheaders[i];
+    if (header.sh_type != SHT_SYMTAB || header.sh_entsize != sizeof(Elf64_Sym))
+      continue;
+    if (header.sh_link >= elf->e_shnum)
+      continue;
+
+    const Elf64_Shdr& strtab = sheaders[header.sh_link];
+    const char* strings = base + strtab.sh_offset;
+
+    const auto* entries =
+        reinterpret_cast<const Elf64_Sym*>(base + header.sh_offset);
+    const size_t count = header.sh_size / sizeof(Elf64_Sym);
+
+    for (size_t j = 0; j < count; ++j) {
+      const Elf64_Sym& sym = entries[j];
+      if (sym.st_shndx == SHN_UNDEF || sym.st_shndx >= SHN_LORESERVE)
+        continue;
+      if (sym.st_name == 0 || sym.st_name >= strtab.sh_size)
+        continue;
+
+      SymbolKind kind;
+      switch (sym.st_info & 0xf) {
+      case STT_FUNC:
+        kind = SymbolKind::Function;
+        break;
+      case STT_OBJECT:
+        kind = SymbolKind::Object;
+        break;
+      case STT_NOTYPE:
+        kind = SymbolKind::Label;
+        break;
+      default:
+        continue;
+      }
+
+      std::string_view name{strings + sym.st_name};
+      /* Skip mapping symbols and assembler-local labels. */
+      if (name.empty() || name[0] == '$' || name.substr(0, 2) == ".L")
+        continue;
+
+      symbols.push_back(Symbol{sym.st_value, sym.st_size, kind,
+                               std::string{name}});
+    }
+  }
+
+  return SymbolTable{std::move(symbols)};
+}
@@ -9,6 +9,7 @@
 #define __ELF_FILE_H__
 
 #include "memory-interface.h"
+#include "symbol-table.h"
 
 #include <memory>
 #include <string>
@@ -18,8 +19,10 @@
 #include <windows.h>
 #endif
 
+class Memory;
+
 /* The ELFFile class loads a program from an ELF file by creating memories
- * for every section that needs to be loaded. During construction of
+ * for every loadable segment. During construction of
  * the Processor class, these memories are added to the memory bus
  * of the system.
  */
@@ -35,6 +38,7 @@ public:
   bool getTextSegment(std::vector<std::byte>& segmentData,
                       MemAddress& segmentBase, size_t& segmentSize) const;
   uint64_t getEntrypoint() const;
+  SymbolTable getSymbolTable() const;
 
   ELFFile(const ELFFile&) = delete;
   ELFFile& operator=(const ELFFile&) = delete;
@@ -51,6 +55,11 @@ private:
 
   bool isBad = true;
 
+  size_t getMappingGranularity() const;
+  std::unique_ptr<Memory> mapSegment(const std::string& name, uint64_t offset,
+                                     MemAddress base, size_t fileSize,
+                                     size_t memSize, bool writable) const;
+
   bool isELF() const;
   bool isTarget(const uint8_t elf_class, const uint8_t endianness,
                 const uint8_t machine) const;
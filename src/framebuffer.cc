@@ -22,11 +22,17 @@
  * - The framebuffer is just a large chunk of memory uploaded to a texture
  *   and rendered to the screen. This isn't the most efficient method
  *   but it is very simple in its design. For the indexed/Y8 modes
- *   we translate it to RGBA8888 first.
+ *   we translate it to RGBA8888 first, using the SIMD kernels of
+ *   pixel-convert.cc the host supports.
+ * - Writes mark the scanlines they touch as dirty. A refresh uploads
+ *   (and translates) only the runs of dirty scanlines, such that small
+ *   updates like sprites do not cost a full-screen upload. Palette and
+ *   mode changes dirty the whole screen.
  * - Two base memory addresses, one for control/palette which only accepts
  *   aligned word size writes.
  *   The other writes directly to the framebuffer memory we allocate.
- * - Refreshes happen every X bus cycles if any of the memory changed.
+ * - Refreshes happen every X bus cycles if any of the memory changed,
+ *   or when the window needs to be presented again.
  *   Refresh frequency can be adjusted with up/down arrow keys.
  *
  * Relevant addresses:
@@ -44,11 +50,15 @@
 
 #ifdef ENABLE_FRAMEBUFFER
 #include "framebuffer.h"
+#include "pixel-convert.h"
 
 #include <SDL.h>
 #include <SDL_events.h>
 #include <SDL_video.h>
 
+#include <algorithm>
+#include <vector>
+
 /* PRIu64 on MSVC */
 #include <cinttypes>
 
@@ -93,6 +103,27 @@ public:
 
   void redrawScreen();
 
+  /* Mark the scanlines covered by size bytes at offset in mem as dirty */
+  void markDirty(const uint32_t offset, const uint32_t size)
+  {
+    const uint32_t first = offset / rowBytes;
+    const uint32_t last = (offset + size - 1) / rowBytes;
+    for (uint32_t y = first; y <= last; y++)
+      dirtyRows[y] = true;
+
+    dirtyFirst = std::min(dirtyFirst, first);
+    dirtyLast = std::max(dirtyLast, last);
+  }
+
+  void markAllDirty()
+  {
+    std::fill(dirtyRows.begin(), dirtyRows.end(), true);
+    dirtyFirst = 0;
+    dirtyLast = resy - 1;
+  }
+
+  bool isDirty() const { return dirtyFirst <= dirtyLast; }
+
   RenderContext(const RenderContext&) = delete;
   RenderContext& operator=(const RenderContext&) = delete;
 
@@ -104,17 +135,32 @@ public:
   size_t memsize{};
 
   bool active = false;
-  bool changed = true;
   uint32_t mode;
   uint32_t resx;
   uint32_t resy;
+
+private:
+  void updateRows(const uint32_t first, const uint32_t count);
+
+  uint32_t rowBytes;
+
+  /* Kernels for the Y8 and indexed modes, chosen for the host CPU */
+  const PixelConverter& converter;
+
+  /* Scanlines written since the last redraw; dirtyFirst and dirtyLast
+   * bound them, dirtyFirst > dirtyLast when there are none.
+   */
+  std::vector<uint8_t> dirtyRows;
+  uint32_t dirtyFirst{};
+  uint32_t dirtyLast{};
 };
 
 static uint32_t palette[256];
 
 RenderContext::RenderContext(const uint32_t resx, const uint32_t resy,
                              const uint32_t mode)
-    : mode{mode}, resx{resx}, resy{resy}
+    : mode{mode}, resx{resx}, resy{resy}, rowBytes{resx * mem_mult[mode]},
+      converter{getPixelConverter()}, dirtyRows(resy)
 {
   /* Create a new window/renderer/texture */
   if (SDL_CreateWindowAndRenderer(resx, resy, 0, &window, &renderer)) {
@@ -135,6 +181,7 @@ RenderContext::RenderContext(const uint32_t resx, const uint32_t resy,
   memsize = resx * resy * mem_mult[mode];
   mem = (uint8_t*)calloc(memsize, sizeof(uint8_t));
   active = true;
+  markAllDirty();
 }
 
 RenderContext::~RenderContext()
@@ -150,41 +197,65 @@ RenderContext::~RenderContext()
     free(mem);
 }
 
-/* Update the texture and render it to the window */
+/* Upload count scanlines starting at scanline first to the texture */
 void
-RenderContext::redrawScreen()
+RenderContext::updateRows(const uint32_t first, const uint32_t count)
 {
+  SDL_Rect rect = {0, (int)first, (int)resx, (int)count};
+
   switch (mode) {
   case FBMODE_RGB332:
   case FBMODE_RGB555:
   case FBMODE_RGB24:
   case FBMODE_RGBA32:
-    SDL_UpdateTexture(texture, NULL, mem, resx * mem_mult[mode]);
+    SDL_UpdateTexture(texture, &rect, &mem[first * rowBytes], rowBytes);
     break;
 
   case FBMODE_Y8:
-  case FBMODE_INDEXED:
+  case FBMODE_INDEXED: {
+    /* pixels points to the start of rect */
     uint8_t* pixels;
     int pitch;
-    SDL_LockTexture(texture, NULL, (void**)&pixels, &pitch);
-    for (uint32_t y = 0; y < resy; y++)
-      for (uint32_t x = 0; x < resx; x++) {
-        uint32_t* p = (uint32_t*)&pixels[pitch * y + x * sizeof(uint32_t)];
-        uint8_t mval = mem[y * resx + x];
-        uint32_t pval = 0;
-        if (mode == FBMODE_Y8)
-          pval = mval << 24 | mval << 16 | mval << 8 | 0xff;
-        else if (mode == FBMODE_INDEXED)
-          pval = palette[mval];
-        *p = pval;
-      }
+    SDL_LockTexture(texture, &rect, (void**)&pixels, &pitch);
+    for (uint32_t y = 0; y < count; y++) {
+      uint32_t* dst = (uint32_t*)&pixels[pitch * y];
+      const uint8_t* src = &mem[(first + y) * resx];
+      if (mode == FBMODE_Y8)
+        converter.convertY8(dst, src, resx);
+      else
+        converter.convertIndexed(dst, src, resx, palette);
+    }
     SDL_UnlockTexture(texture);
     break;
   }
+  }
+}
+
+/* Update the dirty parts of the texture and render it to the window */
+void
+RenderContext::redrawScreen()
+{
+  /* Upload every run of consecutive dirty scanlines as one rectangle */
+  uint32_t y = dirtyFirst;
+  while (y <= dirtyLast && y < resy) {
+    if (!dirtyRows[y]) {
+      y++;
+      continue;
+    }
+
+    uint32_t end = y;
+    while (end <= dirtyLast && dirtyRows[end]) {
+      dirtyRows[end] = false;
+      end++;
+    }
+    updateRows(y, end - y);
+    y = end;
+  }
+  dirtyFirst = resy;
+  dirtyLast = 0;
 
   SDL_RenderCopy(renderer, texture, 0, 0);
   SDL_RenderPresent(renderer);
-  changed = false;
 }
 
 /*
@@ -227,9 +298,16 @@ Framebuffer::processEvents(const bool redraw)
   if (not active_window)
     return;
 
+  bool present = redraw;
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
     switch (event.type) {
+    case SDL_WINDOWEVENT:
+      /* The texture is intact, it only needs to be shown again */
+      if (event.window.event == SDL_WINDOWEVENT_EXPOSED)
+        present = true;
+      break;
+
     case SDL_KEYUP:
       switch (event.key.keysym.sym) {
       case SDLK_ESCAPE:
@@ -270,7 +348,7 @@ Framebuffer::processEvents(const bool redraw)
     SDL_SetWindowTitle(context->window, tmp);
   }
 
-  if (context->changed || redraw)
+  if (context->isDirty() || present)
     context->redrawScreen();
 }
 
@@ -323,6 +401,13 @@ Framebuffer::contains(MemAddress addr) const
   return getZone(addr, 0, NULL) != FBzone::INVALID;
 }
 
+std::vector<MemoryRegion>
+Framebuffer::getRegions() const
+{
+  return {{control_base, sizeof(ControlInterface) + sizeof(palette)},
+          {framebuffer_base, MaxBufferSize}};
+}
+
 uint8_t
 Framebuffer::readByte(MemAddress addr)
 {
@@ -386,7 +471,7 @@ Framebuffer::writeByte(MemAddress addr, uint8_t value)
     throw IllegalAccess("Illegal access on framebuffer");
 
   context->mem[offset] = value;
-  context->changed = true;
+  context->markDirty(offset, sizeof(uint8_t));
 }
 
 void
@@ -398,7 +483,7 @@ Framebuffer::writeHalfWord(MemAddress addr, uint16_t value)
     throw IllegalAccess("Illegal access on framebuffer");
 
   *(uint16_t*)&context->mem[offset] = value;
-  context->changed = true;
+  context->markDirty(offset, sizeof(uint16_t));
 }
 
 void
@@ -430,13 +515,13 @@ Framebuffer::writeWord(MemAddress addr, uint32_t value)
 
   case FBzone::PALETTE:
     palette[offset / sizeof(uint32_t)] = value;
-    if (active_window)
-      context->changed = true;
+    if (active_window && context->mode == FBMODE_INDEXED)
+      context->markAllDirty();
     break;
 
   case FBzone::BUFFER:
     *(uint32_t*)&context->mem[offset] = value;
-    context->changed = true;
+    context->markDirty(offset, sizeof(uint32_t));
     break;
 
   default:
@@ -453,14 +538,14 @@ Framebuffer::writeDoubleWord(MemAddress addr, uint64_t value)
     throw IllegalAccess("Illegal access on framebuffer");
 
   *(uint64_t*)&context->mem[offset] = value;
-  context->changed = true;
+  context->markDirty(offset, sizeof(uint64_t));
 }
 
 void
 Framebuffer::clockPulse()
 {
   if (cycles_since_update > update_freq) {
-    processEvents(true);
+    processEvents(false);
     cycles_since_update = 0;
   }
   ++cycles_since_update;
@@ -43,6 +43,7 @@ public:
   void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
   bool contains(MemAddress addr) const override;
+  std::vector<MemoryRegion> getRegions() const override;
 
   void clockPulse() override;
 
@@ -55,6 +56,11 @@ private:
   const MemAddress control_base;
   const MemAddress framebuffer_base;
 
+  /* Address space reserved for the framebuffer memory, sufficient for
+   * 4096x4096 pixels in RGBA32 mode.
+   */
+  static constexpr size_t MaxBufferSize = 64 * 1024 * 1024;
+
   bool active_window = false;
   bool finished = false;
 
@@ -89,6 +89,7 @@ InstructionDecoder::getInstructionType() const
   case Opcode::OP_IMM_32:
   case Opcode::LOAD:
   case Opcode::JALR:
+  case Opcode::SYSTEM:
     return InstructionType::I_TYPE;
 
   case Opcode::STORE:
@@ -140,8 +141,10 @@ InstructionDecoder::getImmediateB() const
 int64_t
 InstructionDecoder::getImmediateU() const
 {
-  /* U-type: imm[31:12] in bits [31:12], left-shifted by 12 */
-  return static_cast<int64_t>(instructionWord & 0xFFFFF000);
+  /* U-type: imm[31:12] in bits [31:12], left-shifted by 12. On RV64 the
+   * 32-bit result is sign-extended.
+   */
+  return signExtend(instructionWord & 0xFFFFF000, 32);
 }
 
 int64_t
@@ -155,6 +158,12 @@ InstructionDecoder::getImmediateJ() const
   return signExtend(imm, 21);
 }
 
+uint16_t
+InstructionDecoder::getCSR() const
+{
+  return (instructionWord >> 20) & 0xFFF;
+}
+
 int64_t
 InstructionDecoder::getImmediate() const
 {
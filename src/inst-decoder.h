@@ -29,7 +29,8 @@ enum class Opcode : uint8_t {
   JALR = 0x67,      /* I-type: jalr */
   JAL = 0x6F,       /* J-type: jal */
   LUI = 0x37,       /* U-type: lui */
-  AUIPC = 0x17      /* U-type: auipc */
+  AUIPC = 0x17,     /* U-type: auipc */
+  SYSTEM = 0x73     /* I-type: ecall, ebreak, csrrw, csrrs, csrrc, ... */
 };
 
 /* Exception that should be thrown when an illegal instruction
@@ -68,6 +69,9 @@ public:
   int64_t getImmediateU() const;
   int64_t getImmediateJ() const;
 
+  /* CSR number of the Zicsr instructions */
+  uint16_t getCSR() const;
+
 private:
   uint32_t instructionWord;
 };
@@ -271,17 +271,18 @@ formatOpImm(std::ostream& os, const InstructionDecoder& decoder)
     emitUnaryOp(os, "andi", rd, rs1, imm);
     break;
 
+  /* The lowest bit of funct7 is bit 5 of the shift amount */
   case 0x1:
-    if (funct7 == 0x00)
+    if ((funct7 >> 1) == 0x00)
       emitUnaryOp(os, "slli", rd, rs1, imm & 0x3F);
     else
       throw IllegalInstruction("Unknown shift immediate");
     break;
 
   case 0x5:
-    if (funct7 == 0x00)
+    if ((funct7 >> 1) == 0x00)
       emitUnaryOp(os, "srli", rd, rs1, imm & 0x3F);
-    else if (funct7 == 0x20)
+    else if ((funct7 >> 1) == 0x10)
       emitUnaryOp(os, "srai", rd, rs1, imm & 0x3F);
     else
       throw IllegalInstruction("Unknown shift immediate");
@@ -327,6 +328,38 @@ formatOpImm32(std::ostream& os, const InstructionDecoder& decoder)
   }
 }
 
+void
+formatSystem(std::ostream& os, const InstructionDecoder& decoder)
+{
+  static const char* const mnemonics[] = {nullptr,  "csrrw",  "csrrs",
+                                          "csrrc",  nullptr,  "csrrwi",
+                                          "csrrsi", "csrrci"};
+  const uint8_t funct3 = decoder.getFunct3();
+  const RegNumber rd = decoder.getRD();
+  const RegNumber rs1 = decoder.getRS1();
+
+  if (funct3 == 0x0 && rd == 0 && rs1 == 0) {
+    if (decoder.getCSR() == 0x000)
+      os << "ecall";
+    else if (decoder.getCSR() == 0x001)
+      os << "ebreak";
+    else
+      throw IllegalInstruction("Unknown system instruction");
+    return;
+  }
+
+  if (!mnemonics[funct3])
+    throw IllegalInstruction("Unknown system instruction");
+
+  os << mnemonics[funct3] << " " << formatRegister(rd) << ", " << std::hex
+     << std::showbase << decoder.getCSR() << std::dec << std::noshowbase
+     << ", ";
+  if (funct3 & 0x4)
+    os << formatImmediate(rs1);
+  else
+    os << formatRegister(rs1);
+}
+
 } // namespace
 
 std::ostream&
@@ -456,12 +489,16 @@ operator<<(std::ostream& os, const InstructionDecoder& decoder)
 
     case Opcode::LUI:
       os << "lui " << formatRegister(rd) << ", "
-         << formatImmediate(decoder.getImmediateU() >> 12);
+         << formatImmediate((decoder.getImmediateU() >> 12) & 0xFFFFF);
       break;
 
     case Opcode::AUIPC:
       os << "auipc " << formatRegister(rd) << ", "
-         << formatImmediate(decoder.getImmediateU() >> 12);
+         << formatImmediate((decoder.getImmediateU() >> 12) & 0xFFFFF);
+      break;
+
+    case Opcode::SYSTEM:
+      formatSystem(os, decoder);
       break;
 
     default:
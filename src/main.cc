@@ -7,8 +7,10 @@
 
 #include "testing.h"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <regex>
 #include <vector>
 
@@ -20,6 +22,7 @@
 
 #include "elf-file.h"
 #include "processor.h"
+#include "replay.h"
 
 #ifdef _MSC_VER
 /* Defined *somewhere* */
@@ -53,12 +56,78 @@ validateRegisters(const Processor& p,
   return allAsExpected;
 }
 
+/* Parse a RAM region specified as base:size. Both are hexadecimal with
+ * 0x prefix or decimal, the size may have a K, M or G suffix.
+ */
+static MemoryRegion
+parseMemoryRegion(const std::string& spec)
+{
+  const size_t colon = spec.find(':');
+  if (colon == std::string::npos)
+    throw std::invalid_argument("missing size");
+
+  MemoryRegion region;
+  size_t pos;
+  region.base = std::stoull(spec.substr(0, colon), &pos, 0);
+  if (pos != colon)
+    throw std::invalid_argument("malformed base");
+
+  const std::string size = spec.substr(colon + 1);
+  region.size = std::stoull(size, &pos, 0);
+  if (pos + 1 == size.length()) {
+    switch (size[pos]) {
+    case 'G':
+      region.size <<= 10;
+      /* fall through */
+    case 'M':
+      region.size <<= 10;
+      /* fall through */
+    case 'K':
+      region.size <<= 10;
+      break;
+    default:
+      throw std::invalid_argument("malformed size");
+    }
+  } else if (pos != size.length())
+    throw std::invalid_argument("malformed size");
+
+  if (region.size == 0)
+    throw std::invalid_argument("empty region");
+
+  return region;
+}
+
+/* Settings collected from the command line that determine how the
+ * processor is configured.
+ */
+struct LaunchOptions {
+  bool pipelining{};
+  bool debugMode{};
+  std::optional<OoOConfig> outOfOrder{};
+  const char* profileFilename{};
+  const char* foldedFilename{};
+  const char* traceFilename{};
+  const char* pipeViewFilename{};
+  const char* replayFilename{};
+  const char* heatmapFilename{};
+  const char* serialFilename{};
+  const char* inputFilename{};
+  const char* inputLogFilename{};
+  const char* sandboxDirectory{};
+  size_t cosimBatch{}; /* 0 disables co-simulation */
+  bool hostStatistics{};
+  double progressInterval{}; /* seconds, 0 disables the progress line */
+  std::vector<MemoryRegion> ramRegions{};
+  std::vector<std::string> programArguments{};
+  std::vector<std::string> environment{};
+};
+
 /* Start the emulator by either executing a test or running a regular
  * program.
  */
 static int
-launcher(const char* testFilename, const char* execFilename, bool pipelining,
-         bool debugMode, std::vector<RegisterInit> initializers)
+launcher(const char* testFilename, const char* execFilename,
+         const LaunchOptions& options, std::vector<RegisterInit> initializers)
 {
   try {
     std::string programFilename;
@@ -85,15 +154,92 @@ launcher(const char* testFilename, const char* execFilename, bool pipelining,
     } else
       programFilename = std::string(execFilename);
 
+    /* Opened first, the serial device flushes to it when destroyed */
+    std::ofstream serialFile;
+    const bool serialToStdout =
+        options.serialFilename && std::string{options.serialFilename} == "-";
+    if (options.serialFilename && !serialToStdout) {
+      serialFile.open(options.serialFilename);
+      if (!serialFile)
+        throw std::runtime_error("cannot open serial output file " +
+                                 std::string{options.serialFilename});
+    }
+
     /* Read the ELF file and start the emulator */
     ELFFile program(programFilename);
-    Processor p(program, pipelining, debugMode);
+    Processor p(program, options.pipelining, options.debugMode);
+
+    if (serialToStdout)
+      p.setSerialOutput(std::cout);
+    else if (serialFile.is_open())
+      p.setSerialOutput(serialFile);
+
+    if (options.inputFilename) {
+      std::unique_ptr<SerialInput> input =
+          std::make_unique<StreamInput>(options.inputFilename);
+      if (options.inputLogFilename)
+        input = std::make_unique<RecordingInput>(std::move(input),
+                                                 options.inputLogFilename);
+      p.setSerialInput(std::move(input));
+    } else if (options.inputLogFilename)
+      p.setSerialInput(std::make_unique<ReplayInput>(options.inputLogFilename));
+
+    for (const auto& region : options.ramRegions)
+      p.addRAM(region.base, region.size);
+    if (options.outOfOrder)
+      p.useOutOfOrderCore(*options.outOfOrder);
+    if (options.profileFilename || options.foldedFilename)
+      p.enableProfiler(program, options.foldedFilename != nullptr);
+    if (options.traceFilename)
+      p.enableTrace(options.traceFilename);
+    if (options.pipeViewFilename)
+      p.enablePipeView(options.pipeViewFilename);
+    if (options.cosimBatch)
+      p.enableCoSimulation(program, options.cosimBatch);
+    if (options.heatmapFilename)
+      p.enableMemoryAnalyzer();
+    if (options.sandboxDirectory)
+      p.setSandbox(options.sandboxDirectory);
+    if (options.hostStatistics)
+      p.enableHostStatistics(options.progressInterval);
+
+    /* After enabling co-simulation, which also receives the stack */
+    if (!testFilename) {
+      std::vector<std::string> arguments{programFilename};
+      arguments.insert(arguments.end(), options.programArguments.begin(),
+                       options.programArguments.end());
+      p.setProgramArguments(arguments, options.environment);
+    }
 
     for (auto& initializer : initializers)
       p.initRegister(initializer.number, initializer.value);
 
     p.run(testFilename != nullptr);
 
+    if (options.profileFilename) {
+      std::ofstream profile(options.profileFilename);
+      if (!profile)
+        throw std::runtime_error("cannot open profile output file " +
+                                 std::string{options.profileFilename});
+      p.writeProfile(profile);
+    }
+
+    if (options.foldedFilename) {
+      std::ofstream folded(options.foldedFilename);
+      if (!folded)
+        throw std::runtime_error("cannot open folded stacks output file " +
+                                 std::string{options.foldedFilename});
+      p.writeFoldedStacks(folded);
+    }
+
+    if (options.heatmapFilename) {
+      std::ofstream heatmap(options.heatmapFilename);
+      if (!heatmap)
+        throw std::runtime_error("cannot open heatmap output file " +
+                                 std::string{options.heatmapFilename});
+      p.writeMemoryHeatmap(heatmap);
+    }
+
     /* Dump registers and statistics when not running a unit test. */
     if (!testFilename) {
       p.dumpRegisters();
@@ -102,6 +248,10 @@ launcher(const char* testFilename, const char* execFilename, bool pipelining,
 
     if (!validateRegisters(p, postRegisters))
       return ExitCodes::UnitTestFailed;
+
+    /* Let scripted co-simulation runs detect a divergence. */
+    if (p.hasDiverged())
+      return ExitCodes::AbnormalTermination;
   } catch (std::runtime_error& e) {
     std::cerr << "Couldn't load program: " << e.what() << std::endl;
     return ExitCodes::InitializationError;
@@ -113,8 +263,30 @@ launcher(const char* testFilename, const char* execFilename, bool pipelining,
   return ExitCodes::Success;
 }
 
+/* Replay a trace through the timing model instead of running the
+ * program.
+ */
+static int
+replayTrace(const char* execFilename, const LaunchOptions& options)
+{
+  try {
+    ELFFile program(execFilename);
+    TraceReader reader(options.replayFilename);
+
+    TraceReplay replay(reader, program, options.pipelining);
+    replay.run();
+    replay.dumpStatistics();
+  } catch (std::exception& e) {
+    std::cerr << "Couldn't replay trace: " << e.what() << std::endl;
+    return ExitCodes::InitializationError;
+  }
+
+  return ExitCodes::Success;
+}
+
 static void
-formatDisassembly(InstructionDecoder& decoder, MemAddress PC = 0)
+formatDisassembly(InstructionDecoder& decoder, MemAddress PC = 0,
+                  const SymbolTable* symbols = nullptr)
 {
   auto storeFlags(std::cout.flags());
   std::cout << std::hex;
@@ -125,10 +297,25 @@ formatDisassembly(InstructionDecoder& decoder, MemAddress PC = 0)
   std::cout.setf(storeFlags);
 
   try {
-    std::cout << decoder << std::endl;
+    std::cout << decoder;
   } catch (IllegalInstruction& e) {
     std::cout << "illegal instruction" << std::endl;
+    return;
   }
+
+  /* Annotate the targets of direct jumps and branches. */
+  if (symbols && PC != 0) {
+    std::string target;
+    if (decoder.getOpcode() == Opcode::JAL)
+      target = symbols->format(PC + decoder.getImmediateJ());
+    else if (decoder.getOpcode() == Opcode::BRANCH)
+      target = symbols->format(PC + decoder.getImmediateB());
+
+    if (!target.empty())
+      std::cout << "\t<" << target << ">";
+  }
+
+  std::cout << std::endl;
 }
 
 static int
@@ -141,12 +328,24 @@ disasmELFFile(const ELFFile& program)
   if (!program.getTextSegment(segment, segmentBase, segmentSize))
     return ExitCodes::InitializationError;
 
+  const SymbolTable symbols = program.getSymbolTable();
+
   InstructionDecoder decoder;
   size_t i = 0;
   while (i < segmentSize) {
+    /* Print a label at the start of every symbol. */
+    if (const Symbol* symbol = symbols.find(segmentBase + i)) {
+      auto storeFlags(std::cout.flags());
+      if (i != 0)
+        std::cout << std::endl;
+      std::cout << std::hex << "0x" << symbol->address << " <" << symbol->name
+                << ">:" << std::endl;
+      std::cout.flags(storeFlags);
+    }
+
     const RegValue* instr = reinterpret_cast<const RegValue*>(&segment[i]);
     decoder.setInstructionWord(*instr);
-    formatDisassembly(decoder, segmentBase + i);
+    formatDisassembly(decoder, segmentBase + i, &symbols);
     i += 4;
   }
 
@@ -229,29 +428,93 @@ static void
 showHelp(const char* progName)
 {
   std::cerr << "Usage:" << std::endl;
-  std::cerr << progName << " [-d] [-p] [-r REGINIT] <programFilename>"
+  std::cerr << progName
+            << " [-d] [-p | -o | -O OOOCONFIG] [-m BASE:SIZE] [-C BATCH]"
+               " [-M] [-G INTERVAL] [-P PROFILE] [-F FOLDED] [-H HEATMAP]"
+               " [-T TRACE] [-V PIPEVIEW] [-s SERIAL] [-i INPUT]"
+               " [-I INPUTLOG] [-S SANDBOX] [-e NAME=VALUE] [-r REGINIT]"
+               " <programFilename> [arguments...]"
             << std::endl;
   std::cerr << "    or" << std::endl;
-  std::cerr << progName << " [-d] [-p] -t <testFilename>" << std::endl;
+  std::cerr << progName
+            << " [-d] [-p | -o | -O OOOCONFIG] [-C BATCH] -t <testFilename>"
+            << std::endl;
+  std::cerr << "    or" << std::endl;
+  std::cerr << progName << " [-p] -R <traceFilename> <programFilename>"
+            << std::endl;
   std::cerr << "    or" << std::endl;
   std::cerr << progName << " -x <instruction>" << std::endl;
   std::cerr << "    or" << std::endl;
   std::cerr << progName << " -X <filename>" << std::endl;
   std::cerr <<
       R"HERE(
+    -C, co-simulates the core with a reference model of the instruction
+        set. The retired instructions are compared every BATCH
+        instructions and the emulator stops at the first divergence.
+        Use a BATCH of 1 to stop right after the diverging instruction.
     -d, enables debug mode in which every decoded instruction is printed
         to the terminal.
+    -e, adds the variable NAME=VALUE to the environment of the program.
+        Can be given multiple times.
+    -F, tracks the call stack of the program and writes the cycles spent
+        in every call stack to FOLDED, in the folded format used by flame
+        graph tools.
+    -G, like -M, and prints the number of clock cycles and instructions
+        completed so far, and the rates over the last INTERVAL seconds,
+        every INTERVAL seconds while the program runs.
+    -H, counts the instruction fetches, loads and stores to every page
+        and 64-byte line and writes them to HEATMAP as CSV. The dominant
+        address stride of the most frequent memory instructions is
+        printed with the statistics.
     -p, enables pipelining. When omitted, the emulator runs in non-pipelined
         mode.
+    -i, feeds the contents of the file INPUT, or standard input when
+        INPUT is -, to the receive register of the serial device. The
+        input is read in the background while the program runs.
+    -I, with -i, records at which point the program received each part
+        of the input to INPUTLOG. Without -i, replays INPUTLOG such that
+        the program receives the input exactly as in the recorded run.
+    -m, adds SIZE bytes of RAM at address BASE, for instance for a stack
+        or heap. BASE and SIZE are decimal or hexadecimal (0x prefix),
+        SIZE may end in K, M or G. Host memory is only allocated for the
+        pages that the program uses. Can be given multiple times.
+    -M, measures the wall-clock and CPU time of the run and prints them
+        with the statistics, along with the simulated clock rate (MHz)
+        and the instructions completed per second (MIPS) of the host.
+    -o, runs the program on the out-of-order core model instead of the
+        in-order pipeline.
+    -O, like -o, with OOOCONFIG a comma-separated list of key=value
+        settings for the out-of-order core. Keys are width, rob, iq, lsq,
+        prf (physical registers) and loadlat (load latency).
+    -P, profiles every instruction of the text segment and writes an
+        annotated disassembly, hottest instructions first, to PROFILE.
     -r, specifies a register initializer REGINIT, in the form
         rX=Y with X a register number and Y the initializer value.
+    -R, replays traceFilename, a trace written by an earlier run with
+        -T, through the timing model of the (non-)pipelined core instead
+        of executing the program, and prints the resulting statistics.
+    -s, writes the output of the serial device to the file SERIAL, or to
+        standard output when SERIAL is -, instead of standard error.
+    -S, allows the program to open files within the directory SANDBOX
+        using system calls. Paths are resolved relative to SANDBOX.
     -t, enables unit test mode, with testFilename a unit test
         configuration file.
+    -T, writes a compact binary trace with one record for every retired
+        instruction to TRACE. Use rv64-trace to print a trace as text.
+    -V, writes the cycles in which every instruction entered each stage
+        of the in-order pipeline to PIPEVIEW, in the O3PipeView format
+        that can be displayed with Konata.
     -x, disassembles (decodes) a single instruction specified as
         hexadecimal argument.
     -X, disassembles 'filename' which is either an ELF file (in which case
         the text segment is disassembled) or an ASCII file with hexadecimal
         numbers.
+
+    Programs may request Linux system calls with ecall. The arguments
+    following programFilename are passed to the program, together with
+    the environment set with -e, on a stack at the top of the last RAM
+    region. Use -- before programFilename to pass arguments starting
+    with a dash. The heap grows from the start of the first RAM region.
 )HERE";
 }
 
@@ -259,8 +522,7 @@ int
 main(int argc, char** argv)
 {
   char c;
-  bool pipelining = false;
-  bool debugMode = false;
+  LaunchOptions options;
   std::vector<RegisterInit> initializers;
   const char* testFilename = nullptr;
   const char* disasmArg = nullptr;
@@ -269,14 +531,99 @@ main(int argc, char** argv)
   /* Command line option processing */
   const char* progName = argv[0];
 
-  while ((c = getopt(argc, argv, "dpr:t:x:X:h")) != -1) {
+  while ((c = getopt(argc, argv,
+                     "C:de:F:G:H:i:I:m:MoO:pP:r:R:s:S:t:T:V:x:X:h")) != -1) {
     switch (c) {
+    case 'C':
+      try {
+        size_t pos;
+        options.cosimBatch = std::stoul(optarg, &pos);
+        if (optarg[pos] != '\0' || options.cosimBatch == 0)
+          throw std::invalid_argument(optarg);
+      } catch (std::exception&) {
+        std::cerr << "Error: Malformed co-simulation batch size " << optarg
+                  << std::endl;
+        return ExitCodes::InvalidArgument;
+      }
+      break;
+
     case 'd':
-      debugMode = true;
+      options.debugMode = true;
+      break;
+
+    case 'e':
+      if (!std::strchr(optarg, '=')) {
+        std::cerr << "Error: Malformed environment variable " << optarg
+                  << std::endl;
+        return ExitCodes::InvalidArgument;
+      }
+      options.environment.push_back(optarg);
+      break;
+
+    case 'F':
+      options.foldedFilename = optarg;
+      break;
+
+    case 'G':
+      try {
+        size_t pos;
+        options.progressInterval = std::stod(optarg, &pos);
+        if (optarg[pos] != '\0' || !(options.progressInterval > 0.0))
+          throw std::invalid_argument(optarg);
+      } catch (std::exception&) {
+        std::cerr << "Error: Malformed progress interval " << optarg
+                  << std::endl;
+        return ExitCodes::InvalidArgument;
+      }
+      options.hostStatistics = true;
+      break;
+
+    case 'H':
+      options.heatmapFilename = optarg;
+      break;
+
+    case 'i':
+      options.inputFilename = optarg;
+      break;
+
+    case 'I':
+      options.inputLogFilename = optarg;
+      break;
+
+    case 'm':
+      try {
+        options.ramRegions.push_back(parseMemoryRegion(optarg));
+      } catch (std::exception&) {
+        std::cerr << "Error: Malformed RAM region " << optarg << std::endl;
+        return ExitCodes::InvalidArgument;
+      }
+      break;
+
+    case 'M':
+      options.hostStatistics = true;
+      break;
+
+    case 'o':
+      if (!options.outOfOrder)
+        options.outOfOrder = OoOConfig{};
+      break;
+
+    case 'O':
+      try {
+        options.outOfOrder = OoOConfig{optarg};
+      } catch (std::exception&) {
+        std::cerr << "Error: Malformed out-of-order configuration " << optarg
+                  << std::endl;
+        return ExitCodes::InvalidArgument;
+      }
       break;
 
     case 'p':
-      pipelining = true;
+      options.pipelining = true;
+      break;
+
+    case 'P':
+      options.profileFilename = optarg;
       break;
 
     case 'r':
@@ -296,6 +643,18 @@ main(int argc, char** argv)
       }
       break;
 
+    case 'R':
+      options.replayFilename = optarg;
+      break;
+
+    case 's':
+      options.serialFilename = optarg;
+      break;
+
+    case 'S':
+      options.sandboxDirectory = optarg;
+      break;
+
     case 't':
       if (testFilename != nullptr) {
         std::cerr << "Error: Cannot specify testfile more than once."
@@ -306,6 +665,14 @@ main(int argc, char** argv)
       testFilename = optarg;
       break;
 
+    case 'T':
+      options.traceFilename = optarg;
+      break;
+
+    case 'V':
+      options.pipeViewFilename = optarg;
+      break;
+
     case 'x':
       if (disasmArg != nullptr) {
         std::cerr << "Error: cannot specify -x or -X more than once."
@@ -352,5 +719,28 @@ main(int argc, char** argv)
     return ExitCodes::InvalidArgument;
   }
 
-  return launcher(testFilename, argv[0], pipelining, debugMode, initializers);
+  if (argc > 1)
+    options.programArguments.assign(argv + 1, argv + argc);
+
+  if (options.pipelining && options.outOfOrder) {
+    std::cerr << "Error: -p cannot be combined with the out-of-order core."
+              << std::endl;
+    return ExitCodes::InvalidArgument;
+  }
+
+  if (options.pipeViewFilename && options.outOfOrder) {
+    std::cerr << "Error: -V is only supported for the in-order pipeline."
+              << std::endl;
+    return ExitCodes::InvalidArgument;
+  }
+
+  if (options.replayFilename) {
+    if (options.outOfOrder || testFilename) {
+      std::cerr << "Error: -R cannot be combined with -o or -t." << std::endl;
+      return ExitCodes::InvalidArgument;
+    }
+    return replayTrace(argv[0], options);
+  }
+
+  return launcher(testFilename, argv[0], options, initializers);
 }
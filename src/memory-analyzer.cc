@@ -0,0 +1,174 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    memory-analyzer.cc - Memory access heatmap and stride analysis.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "memory-analyzer.h"
+
+#include "memory-bus.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+MemoryAnalyzer::MemoryAnalyzer(const SymbolTable* symbols) : symbols{symbols}
+{
+}
+
+void
+MemoryAnalyzer::recordStride(MemAddress PC, MemAddress addr)
+{
+  const MemAddress page = PC >> PageBits;
+  if (page != lastCodePage) {
+    lastCodePage = page;
+    lastSlots = strideSlots.lookup(page);
+  }
+  if (!lastSlots)
+    return;
+
+  uint32_t& slot = (*lastSlots)[(PC >> 1) & (SlotsPerPage - 1)];
+  if (slot == 0) {
+    strides.push_back(StrideHistory{PC});
+    slot = strides.size();
+  }
+
+  StrideHistory& history = strides[slot - 1];
+  if (history.accesses++ > 0) {
+    const int64_t stride = static_cast<int64_t>(addr - history.lastAddr);
+
+    size_t i = 0;
+    while (i < history.nStrides && history.strides[i] != stride)
+      ++i;
+
+    if (i < history.nStrides)
+      ++history.counts[i];
+    else if (history.nStrides < MaxStrides) {
+      history.strides[history.nStrides] = stride;
+      history.counts[history.nStrides++] = 1;
+    } else
+      ++history.otherStrides;
+  }
+  history.lastAddr = addr;
+}
+
+/* Classify the client holding addr by the access it permits */
+static const char*
+getClientKind(MemoryBus& bus, MemAddress addr)
+{
+  DirectMemoryRange range;
+  if (!bus.getDirectMemoryRange(addr, range))
+    return "mmio";
+  return range.mayExecute ? "text" : "data";
+}
+
+void
+MemoryAnalyzer::writeHeatmap(std::ostream& os, MemoryBus& bus) const
+{
+  std::vector<MemAddress> pages = lines.getPages();
+  std::sort(pages.begin(), pages.end());
+
+  auto storeFlags(os.flags());
+  os << "granularity,address,client,fetches,reads,writes" << std::endl;
+
+  auto writeRow = [&os, &bus](const char* granularity, MemAddress addr,
+                              MemAddress clientAddr, const Counters& counters) {
+    os << granularity << "," << std::hex << std::showbase << addr << std::dec
+       << "," << getClientKind(bus, clientAddr) << ","
+       << counters[static_cast<size_t>(AccessKind::Fetch)] << ","
+       << counters[static_cast<size_t>(AccessKind::Read)] << ","
+       << counters[static_cast<size_t>(AccessKind::Write)] << "\n";
+  };
+
+  auto touched = [](const Counters& counters) {
+    return std::any_of(counters.begin(), counters.end(),
+                       [](uint64_t count) { return count > 0; });
+  };
+
+  /* A page is attributed to the client of the first line touched in
+   * it, the start of the page may not be mapped.
+   */
+  for (MemAddress page : pages) {
+    const LineCounters& pageLines = lines.get(page);
+
+    Counters sum{};
+    MemAddress clientAddr{};
+    bool first = true;
+    for (size_t line = 0; line < LinesPerPage; ++line) {
+      if (!touched(pageLines[line]))
+        continue;
+      if (first) {
+        clientAddr = page << PageBits | line << LineBits;
+        first = false;
+      }
+      for (size_t i = 0; i < NumAccessKinds; ++i)
+        sum[i] += pageLines[line][i];
+    }
+    writeRow("page", page << PageBits, clientAddr, sum);
+  }
+
+  for (MemAddress page : pages) {
+    const LineCounters& pageLines = lines.get(page);
+    for (size_t line = 0; line < LinesPerPage; ++line) {
+      const MemAddress addr = page << PageBits | line << LineBits;
+      if (touched(pageLines[line]))
+        writeRow("line", addr, addr, pageLines[line]);
+    }
+  }
+
+  os.flags(storeFlags);
+}
+
+void
+MemoryAnalyzer::dumpStrides(std::ostream& os, size_t maxInstructions) const
+{
+  std::vector<const StrideHistory*> sorted;
+  for (const auto& history : strides)
+    sorted.push_back(&history);
+
+  std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {
+    if (a->accesses != b->accesses)
+      return a->accesses > b->accesses;
+    return a->PC < b->PC;
+  });
+  if (sorted.size() > maxInstructions)
+    sorted.resize(maxInstructions);
+
+  auto storeFlags(os.flags());
+  os << "Dominant strides of the most frequent memory instructions:"
+     << std::endl;
+
+  for (const StrideHistory* history : sorted) {
+    const MemAddress PC = history->PC;
+    const auto dominant =
+        std::max_element(history->counts.begin(),
+                         history->counts.begin() + history->nStrides);
+
+    std::stringstream address;
+    address << std::hex << std::showbase << PC << ":";
+    os << "  " << std::setfill(' ') << std::left << std::setw(12)
+       << address.str() << std::right << std::setw(10) << history->accesses
+       << " accesses";
+
+    if (history->nStrides == 0)
+      os << ", no stride";
+    else {
+      const size_t i = dominant - history->counts.begin();
+      const double share = 100.0 * *dominant / (history->accesses - 1);
+      os << ", stride " << std::setw(6) << history->strides[i] << " ("
+         << std::fixed << std::setprecision(1) << share << "%)";
+      os.flags(storeFlags);
+    }
+
+    if (symbols) {
+      std::string name = symbols->format(PC);
+      if (!name.empty())
+        os << "\t<" << name << ">";
+    }
+    os << std::endl;
+  }
+
+  os.flags(storeFlags);
+}
@@ -0,0 +1,180 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    memory-analyzer.h - Memory access heatmap and stride analysis.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __MEMORY_ANALYZER_H__
+#define __MEMORY_ANALYZER_H__
+
+#include "arch.h"
+#include "symbol-table.h"
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+class MemoryBus;
+
+/* Counts the accesses made through the memory bus per cache-line-sized
+ * bucket, separately for instruction fetches, loads and stores. The
+ * memory bus reports every access it counts in its byte counters. Page
+ * counts are derived from the line counts when the heatmap is written,
+ * as is the kind of client (text, data or MMIO) that holds each line.
+ *
+ * For every load and store instruction, identified by its PC, the
+ * strides between the addresses of consecutive accesses are tracked to
+ * find the dominant stride.
+ *
+ * The counters of a page are kept in a flat array, found through a
+ * two-level radix table like the one the memory bus decodes addresses
+ * with. Recording an access thus indexes two arrays, which is skipped
+ * for consecutive accesses to the same page, and increments a counter.
+ */
+class MemoryAnalyzer {
+public:
+  static constexpr unsigned LineBits = 6;
+  static constexpr unsigned PageBits = 12;
+
+  MemoryAnalyzer(const SymbolTable* symbols = nullptr);
+
+  MemoryAnalyzer(const MemoryAnalyzer&) = delete;
+  MemoryAnalyzer& operator=(const MemoryAnalyzer&) = delete;
+
+  void recordFetch(MemAddress addr)
+  {
+    ++lookupLine(addr)[static_cast<size_t>(AccessKind::Fetch)];
+  }
+
+  void recordRead(MemAddress PC, MemAddress addr)
+  {
+    ++lookupLine(addr)[static_cast<size_t>(AccessKind::Read)];
+    recordStride(PC, addr);
+  }
+
+  void recordWrite(MemAddress PC, MemAddress addr)
+  {
+    ++lookupLine(addr)[static_cast<size_t>(AccessKind::Write)];
+    recordStride(PC, addr);
+  }
+
+  /* Write the heatmap as CSV: one row per touched page, followed by one
+   * row per touched line, both in address order.
+   */
+  void writeHeatmap(std::ostream& os, MemoryBus& bus) const;
+
+  /* Print the dominant stride of the instructions that accessed memory
+   * most often.
+   */
+  void dumpStrides(std::ostream& os, size_t maxInstructions = 10) const;
+
+private:
+  enum class AccessKind { Fetch, Read, Write };
+  static constexpr size_t NumAccessKinds = 3;
+
+  using Counters = std::array<uint64_t, NumAccessKinds>;
+
+  /* A small histogram of the strides seen by an instruction. Strides
+   * that do not fit are only counted as other strides.
+   */
+  static constexpr size_t MaxStrides = 8;
+
+  struct StrideHistory {
+    MemAddress PC{};
+    MemAddress lastAddr{};
+    uint64_t accesses{};
+    uint64_t otherStrides{};
+    std::array<int64_t, MaxStrides> strides{};
+    std::array<uint64_t, MaxStrides> counts{};
+    size_t nStrides{};
+  };
+
+  static constexpr unsigned TableBits = 12;
+  static constexpr unsigned DirectoryBits = 16;
+  static constexpr MemAddress TableMask = (1 << TableBits) - 1;
+
+  /* Maps page numbers to a T that is allocated when the page is first
+   * looked up. Addresses the bus cannot decode have no page.
+   */
+  template <typename T> class PageMap {
+  public:
+    PageMap() : directory(1 << DirectoryBits) {}
+
+    T* lookup(MemAddress page)
+    {
+      if (page >> (TableBits + DirectoryBits))
+        return nullptr;
+
+      auto& table = directory[page >> TableBits];
+      if (!table)
+        table = std::make_unique<Table>();
+
+      auto& entry = (*table)[page & TableMask];
+      if (!entry) {
+        entry = std::make_unique<T>();
+        pages.push_back(page);
+      }
+      return entry.get();
+    }
+
+    const T& get(MemAddress page) const
+    {
+      return *(*directory[page >> TableBits])[page & TableMask];
+    }
+
+    /* The pages looked up so far, in the order of their first lookup */
+    const std::vector<MemAddress>& getPages() const { return pages; }
+
+  private:
+    using Table = std::array<std::unique_ptr<T>, 1 << TableBits>;
+
+    std::vector<std::unique_ptr<Table>> directory;
+    std::vector<MemAddress> pages{};
+  };
+
+  static constexpr size_t LinesPerPage = 1 << (PageBits - LineBits);
+  using LineCounters = std::array<Counters, LinesPerPage>;
+
+  /* Instructions are at least two-byte aligned. A slot holds the index
+   * of the instruction's history plus one, or 0 if it has none yet.
+   */
+  static constexpr size_t SlotsPerPage = 1 << (PageBits - 1);
+  using StrideSlots = std::array<uint32_t, SlotsPerPage>;
+
+  const SymbolTable* symbols; /* no ownership, may be nullptr */
+
+  PageMap<LineCounters> lines{};
+  PageMap<StrideSlots> strideSlots{};
+  std::vector<StrideHistory> strides{};
+
+  /* Accesses to addresses the bus cannot decode fault and are not
+   * part of the heatmap.
+   */
+  LineCounters undecodedLines{};
+
+  /* Consecutive accesses mostly hit the same page, and are mostly made
+   * by instructions in the same page.
+   */
+  MemAddress lastPage{~MemAddress{}};
+  LineCounters* lastLines{};
+  MemAddress lastCodePage{~MemAddress{}};
+  StrideSlots* lastSlots{};
+
+  Counters& lookupLine(MemAddress addr)
+  {
+    const MemAddress page = addr >> PageBits;
+    if (page != lastPage) {
+      lastPage = page;
+      lastLines = lines.lookup(page);
+      if (!lastLines)
+        lastLines = &undecodedLines;
+    }
+    return (*lastLines)[(addr >> LineBits) & (LinesPerPage - 1)];
+  }
+
+  void recordStride(MemAddress PC, MemAddress addr);
+};
+
+#endif /* __MEMORY_ANALYZER_H__ */
@@ -7,9 +7,85 @@
 
 #include "memory-bus.h"
 
+#include <algorithm>
+
+/* Several clients mapped in the same page, the first one that contains
+ * the address handles the access.
+ */
+class MemoryBus::SharedPage : public MemoryInterface {
+public:
+  void addClient(MemoryInterface* client) { clients.push_back(client); }
+
+  /* MemoryInterface */
+  uint8_t readByte(MemAddress addr) override
+  {
+    return getClient(addr)->readByte(addr);
+  }
+  uint16_t readHalfWord(MemAddress addr) override
+  {
+    return getClient(addr)->readHalfWord(addr);
+  }
+  uint32_t readWord(MemAddress addr) override
+  {
+    return getClient(addr)->readWord(addr);
+  }
+  uint64_t readDoubleWord(MemAddress addr) override
+  {
+    return getClient(addr)->readDoubleWord(addr);
+  }
+
+  void writeByte(MemAddress addr, uint8_t value) override
+  {
+    getClient(addr)->writeByte(addr, value);
+  }
+  void writeHalfWord(MemAddress addr, uint16_t value) override
+  {
+    getClient(addr)->writeHalfWord(addr, value);
+  }
+  void writeWord(MemAddress addr, uint32_t value) override
+  {
+    getClient(addr)->writeWord(addr, value);
+  }
+  void writeDoubleWord(MemAddress addr, uint64_t value) override
+  {
+    getClient(addr)->writeDoubleWord(addr, value);
+  }
+
+  bool contains(MemAddress addr) const override
+  {
+    return std::any_of(clients.begin(), clients.end(),
+                       [addr](auto* client) { return client->contains(addr); });
+  }
+
+  std::vector<MemoryRegion> getRegions() const override { return {}; }
+
+  bool getDirectMemoryRange(MemAddress addr, DirectMemoryRange& range) override
+  {
+    for (auto* client : clients)
+      if (client->contains(addr))
+        return client->getDirectMemoryRange(addr, range);
+
+    return false;
+  }
+
+private:
+  std::vector<MemoryInterface*> clients{};
+
+  MemoryInterface* getClient(MemAddress addr)
+  {
+    for (auto* client : clients)
+      if (client->contains(addr))
+        return client;
+
+    throw IllegalAccess(addr);
+  }
+};
+
 MemoryBus::MemoryBus(std::vector<std::unique_ptr<MemoryInterface>>&& clients)
-    : clients{std::move(clients)}
+    : clients{std::move(clients)}, directory(1 << DirectoryBits)
 {
+  for (auto& client : this->clients)
+    mapClient(client.get());
 }
 
 MemoryBus::~MemoryBus() = default;
@@ -17,6 +93,7 @@ MemoryBus::~MemoryBus() = default;
 void
 MemoryBus::addClient(std::unique_ptr<MemoryInterface> client)
 {
+  mapClient(client.get());
   clients.emplace_back(std::move(client));
 }
 
@@ -35,64 +112,83 @@ MemoryBus::getBytesWritten() const
 uint8_t
 MemoryBus::readByte(MemAddress addr)
 {
-  bytesRead += 1;
+  recordRead(addr, 1);
   return getClient(addr)->readByte(addr);
 }
 
 uint16_t
 MemoryBus::readHalfWord(MemAddress addr)
 {
-  bytesRead += 2;
+  recordRead(addr, 2);
   return getClient(addr)->readHalfWord(addr);
 }
 
 uint32_t
 MemoryBus::readWord(MemAddress addr)
 {
-  bytesRead += 4;
+  recordRead(addr, 4);
   return getClient(addr)->readWord(addr);
 }
 
 uint64_t
 MemoryBus::readDoubleWord(MemAddress addr)
 {
-  bytesRead += 8;
+  recordRead(addr, 8);
   return getClient(addr)->readDoubleWord(addr);
 }
 
 void
 MemoryBus::writeByte(MemAddress addr, uint8_t value)
 {
-  bytesWritten += 1;
+  recordWrite(addr, 1);
   return getClient(addr)->writeByte(addr, value);
 }
 
 void
 MemoryBus::writeHalfWord(MemAddress addr, uint16_t value)
 {
-  bytesWritten += 2;
+  recordWrite(addr, 2);
   return getClient(addr)->writeHalfWord(addr, value);
 }
 
 void
 MemoryBus::writeWord(MemAddress addr, uint32_t value)
 {
-  bytesWritten += 4;
+  recordWrite(addr, 4);
   return getClient(addr)->writeWord(addr, value);
 }
 
 void
 MemoryBus::writeDoubleWord(MemAddress addr, uint64_t value)
 {
-  bytesWritten += 8;
+  recordWrite(addr, 8);
   return getClient(addr)->writeDoubleWord(addr, value);
 }
 
 bool
 MemoryBus::contains(MemAddress addr) const
 {
-  /* dummy */
-  return true;
+  auto* client = findClient(addr);
+  return client && client->contains(addr);
+}
+
+std::vector<MemoryRegion>
+MemoryBus::getRegions() const
+{
+  std::vector<MemoryRegion> regions;
+  for (auto& client : clients) {
+    auto clientRegions = client->getRegions();
+    regions.insert(regions.end(), clientRegions.begin(), clientRegions.end());
+  }
+
+  return regions;
+}
+
+bool
+MemoryBus::getDirectMemoryRange(MemAddress addr, DirectMemoryRange& range)
+{
+  auto* client = findClient(addr);
+  return client && client->getDirectMemoryRange(addr, range);
 }
 
 void
@@ -105,22 +201,103 @@ MemoryBus::clockPulse()
 /*
  * Private methods
  */
-MemoryInterface*
-MemoryBus::findClient(MemAddress addr) noexcept
+
+/* Enter the regions of client in the page table, after verifying that
+ * these do not overlap with any client mapped before.
+ */
+void
+MemoryBus::mapClient(MemoryInterface* client)
 {
-  for (auto& client : clients)
-    if (client->contains(addr))
-      return client.get();
+  const auto regions = client->getRegions();
+
+  for (const auto& region : regions) {
+    if (region.size == 0)
+      continue;
+
+    const MemAddress last = region.base + (region.size - 1);
+    if (last < region.base || last >> AddressBits) {
+      std::stringstream ss;
+      ss << "memory region at " << std::hex << std::showbase << region.base
+         << " is outside of the address space";
+      throw std::runtime_error(ss.str());
+    }
+
+    for (auto& other : clients) {
+      if (other.get() == client)
+        continue;
+      for (const auto& mapped : other->getRegions()) {
+        if (mapped.size != 0 && region.base < mapped.base + mapped.size &&
+            mapped.base < region.base + region.size) {
+          std::stringstream ss;
+          ss << "memory region at " << std::hex << std::showbase
+             << region.base << " overlaps with region at " << mapped.base;
+          throw std::runtime_error(ss.str());
+        }
+      }
+    }
+  }
 
-  return nullptr;
+  constexpr MemAddress TableEntries = MemAddress{1} << TableBits;
+  PageTable* uniform = nullptr;
+
+  for (const auto& region : regions) {
+    if (region.size == 0)
+      continue;
+
+    const MemAddress end = region.base + region.size;
+    const MemAddress last = (end - 1) >> PageBits;
+
+    MemAddress page = region.base >> PageBits;
+    while (page <= last) {
+      const MemAddress nextTable = (page | (TableEntries - 1)) + 1;
+
+      /* Other clients cannot be mapped within a table the region fully
+       * covers, so these refer to a single table for this client.
+       */
+      if ((page & (TableEntries - 1)) == 0 &&
+          (page << PageBits) >= region.base &&
+          (nextTable << PageBits) <= end) {
+        if (!uniform) {
+          tables.push_back(std::make_unique<PageTable>());
+          uniform = tables.back().get();
+          uniform->fill(client);
+        }
+        directory[page >> TableBits] = uniform;
+        page = nextTable;
+        continue;
+      }
+
+      mapPage(page, client);
+      ++page;
+    }
+  }
 }
 
-MemoryInterface*
-MemoryBus::getClient(MemAddress addr)
+void
+MemoryBus::mapPage(MemAddress page, MemoryInterface* client)
 {
-  auto* client = findClient(addr);
-  if (!client)
-    throw IllegalAccess(addr);
+  auto& table = directory[page >> TableBits];
+  if (!table) {
+    tables.push_back(std::make_unique<PageTable>());
+    table = tables.back().get();
+  }
+
+  auto& entry = (*table)[page & ((1 << TableBits) - 1)];
+  if (!entry || entry == client) {
+    entry = client;
+    return;
+  }
+
+  /* The page is shared with another client */
+  auto shared = std::find_if(
+      sharedPages.begin(), sharedPages.end(),
+      [entry](const auto& sharedPage) { return sharedPage.get() == entry; });
+  if (shared == sharedPages.end()) {
+    sharedPages.push_back(std::make_unique<SharedPage>());
+    sharedPages.back()->addClient(entry);
+    shared = std::prev(sharedPages.end());
+  }
 
-  return client;
+  (*shared)->addClient(client);
+  entry = shared->get();
 }
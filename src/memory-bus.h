@@ -8,21 +8,66 @@
 #ifndef __MEMORY_BUS_H__
 #define __MEMORY_BUS_H__
 
+#include "memory-analyzer.h"
 #include "memory-interface.h"
 
+#include <array>
 #include <memory>
 #include <vector>
 
+/* The bus decodes addresses to clients with a two-level radix table
+ * indexed by page number, which is filled when clients are added. A
+ * lookup therefore takes constant time, regardless of the number of
+ * clients. Pages in which more than one client is mapped, which is
+ * typical for small devices, refer to a SharedPage that selects the
+ * client using contains(). Clients may not overlap.
+ */
 class MemoryBus : public MemoryInterface {
 public:
   MemoryBus(std::vector<std::unique_ptr<MemoryInterface>>&& clients);
   ~MemoryBus() override;
 
+  MemoryBus(const MemoryBus&) = delete;
+  MemoryBus& operator=(const MemoryBus&) = delete;
+
   void addClient(std::unique_ptr<MemoryInterface> client);
 
   uint64_t getBytesRead() const;
   uint64_t getBytesWritten() const;
 
+  /* Report every access to analyzer, which may be nullptr. */
+  void setAnalyzer(MemoryAnalyzer* analyzer) { this->analyzer = analyzer; }
+
+  /* The PC of the instruction making the following data accesses, as
+   * reported to the analyzer.
+   */
+  void setAccessPC(MemAddress PC) { accessPC = PC; }
+
+  /* Count an access. Accesses made through a direct memory range
+   * bypass the bus and must be reported using these methods. All
+   * instructions are fetched this way.
+   */
+  void recordFetch(MemAddress addr, size_t bytes)
+  {
+    bytesRead += bytes;
+    if (analyzer)
+      analyzer->recordFetch(addr);
+  }
+
+  void recordRead(MemAddress addr, size_t bytes)
+  {
+    bytesRead += bytes;
+    if (analyzer)
+      analyzer->recordRead(accessPC, addr);
+  }
+
+  void recordWrite(MemAddress addr, size_t bytes)
+  {
+    bytesWritten += bytes;
+    if (analyzer)
+      analyzer->recordWrite(accessPC, addr);
+  }
+
   /* MemoryInterface */
   uint8_t readByte(MemAddress addr) override;
   uint16_t readHalfWord(MemAddress addr) override;
@@ -35,17 +80,61 @@ public:
   void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
   bool contains(MemAddress addr) const override;
+  std::vector<MemoryRegion> getRegions() const override;
+  bool getDirectMemoryRange(MemAddress addr,
+                            DirectMemoryRange& range) override;
 
   void clockPulse() override;
 
 private:
+  class SharedPage;
+
+  static constexpr unsigned PageBits = 12;
+  static constexpr unsigned TableBits = 12;
+  static constexpr unsigned DirectoryBits = 16;
+  static constexpr unsigned AddressBits = PageBits + TableBits + DirectoryBits;
+
+  using PageTable = std::array<MemoryInterface*, 1 << TableBits>;
+
   std::vector<std::unique_ptr<MemoryInterface>> clients;
+  std::vector<std::unique_ptr<SharedPage>> sharedPages{};
+
+  /* Second-level tables in which all pages belong to one client are
+   * shared by all such parts of its regions, so mapping large regions
+   * takes little time and host memory.
+   */
+  std::vector<PageTable*> directory;
+  std::vector<std::unique_ptr<PageTable>> tables{};
+
+  void mapClient(MemoryInterface* client);
+  void mapPage(MemAddress page, MemoryInterface* client);
 
-  MemoryInterface* findClient(MemAddress addr) noexcept;
-  MemoryInterface* getClient(MemAddress addr);
+  MemoryInterface* findClient(MemAddress addr) const noexcept
+  {
+    if (addr >> AddressBits)
+      return nullptr;
+
+    const MemAddress page = addr >> PageBits;
+    const auto& table = directory[page >> TableBits];
+    if (!table)
+      return nullptr;
+    return (*table)[page & ((1 << TableBits) - 1)];
+  }
+
+  MemoryInterface* getClient(MemAddress addr)
+  {
+    auto* client = findClient(addr);
+    if (!client)
+      throw IllegalAccess(addr);
+
+    return client;
+  }
 
   uint64_t bytesRead = 0;    /* Bytes read from bus */
   uint64_t bytesWritten = 0; /* Bytes written to bus */
+
+  MemoryAnalyzer* analyzer{}; /* no ownership */
+  MemAddress accessPC{};
 };
 
 #endif /* __MEMORY_BUS_H__ */
@@ -30,16 +30,23 @@ InstructionMemory::setAddress(const MemAddress addr)
 RegValue
 InstructionMemory::getValue() const
 {
-  switch (size) {
-  case 2:
-    return bus.readHalfWord(addr);
+  if (size != 2 && size != 4)
+    throw IllegalAccess("Invalid size " + std::to_string(size));
 
-  case 4:
-    return bus.readWord(addr);
+  /* Instructions are fetched directly from host memory. Memory that is
+   * not backed by host memory, such as devices, is never executable.
+   */
+  if (!direct.covers(addr, size) &&
+      !(bus.getDirectMemoryRange(addr, direct) && direct.covers(addr, size)))
+    throw IllegalAccess(addr, size);
 
-  default:
-    throw IllegalAccess("Invalid size " + std::to_string(size));
-  }
+  if (!direct.mayExecute)
+    throw IllegalAccess(addr, size);
+
+  bus.recordFetch(addr, size);
+  if (size == 4)
+    return direct.read<uint32_t>(addr);
+  return direct.read<uint16_t>(addr);
 }
 
 DataMemory::DataMemory(MemoryBus& bus) : bus{bus} {}
@@ -54,6 +61,13 @@ DataMemory::setSize(const uint8_t size)
   this->size = size;
 }
 
+/* Only used to attribute accesses to instructions when analyzing */
+void
+DataMemory::setPC(const MemAddress PC)
+{
+  bus.setAccessPC(PC);
+}
+
 void
 DataMemory::setAddress(const MemAddress addr)
 {
@@ -78,6 +92,56 @@ DataMemory::setWriteEnable(bool setting)
   writeEnable = setting;
 }
 
+/* Make sure direct holds the RAM region containing the access, if
+ * any. Device accesses use the memory bus.
+ */
+bool
+DataMemory::lookupDirect() const
+{
+  return direct.covers(addr, size) ||
+         (bus.getDirectMemoryRange(addr, direct) && direct.covers(addr, size));
+}
+
+template <typename T>
+T
+DataMemory::read() const
+{
+  if (lookupDirect()) {
+    bus.recordRead(addr, sizeof(T));
+    return direct.read<T>(addr);
+  }
+
+  if constexpr (sizeof(T) == 1)
+    return bus.readByte(addr);
+  else if constexpr (sizeof(T) == 2)
+    return bus.readHalfWord(addr);
+  else if constexpr (sizeof(T) == 4)
+    return bus.readWord(addr);
+  else
+    return bus.readDoubleWord(addr);
+}
+
+template <typename T>
+void
+DataMemory::write(T value) const
+{
+  /* Writes to read-only memory are rejected by the memory itself */
+  if (lookupDirect() && direct.mayWrite) {
+    bus.recordWrite(addr, sizeof(T));
+    direct.write<T>(addr, value);
+    return;
+  }
+
+  if constexpr (sizeof(T) == 1)
+    bus.writeByte(addr, value);
+  else if constexpr (sizeof(T) == 2)
+    bus.writeHalfWord(addr, value);
+  else if constexpr (sizeof(T) == 4)
+    bus.writeWord(addr, value);
+  else
+    bus.writeDoubleWord(addr, value);
+}
+
 RegValue
 DataMemory::getDataOut(bool signExtend) const
 {
@@ -89,7 +153,7 @@ DataMemory::getDataOut(bool signExtend) const
   switch (size) {
   case 1: /* Byte */
   {
-    uint8_t byte = bus.readByte(addr);
+    uint8_t byte = read<uint8_t>();
     if (signExtend)
       data = static_cast<int64_t>(static_cast<int8_t>(byte));
     else
@@ -98,7 +162,7 @@ DataMemory::getDataOut(bool signExtend) const
 
   case 2: /* Half-word (16-bit) */
   {
-    uint16_t half = bus.readHalfWord(addr);
+    uint16_t half = read<uint16_t>();
     if (signExtend)
       data = static_cast<int64_t>(static_cast<int16_t>(half));
     else
@@ -107,7 +171,7 @@ DataMemory::getDataOut(bool signExtend) const
 
   case 4: /* Word (32-bit) */
   {
-    uint32_t word = bus.readWord(addr);
+    uint32_t word = read<uint32_t>();
     if (signExtend)
       data = static_cast<int64_t>(static_cast<int32_t>(word));
     else
@@ -115,7 +179,7 @@ DataMemory::getDataOut(bool signExtend) const
   } break;
 
   case 8: /* Double-word (64-bit) */
-    data = bus.readDoubleWord(addr);
+    data = read<uint64_t>();
     break;
 
   default:
@@ -134,19 +198,19 @@ DataMemory::clockPulse() const
   /* Write to memory based on size */
   switch (size) {
   case 1: /* Byte */
-    bus.writeByte(addr, static_cast<uint8_t>(dataIn));
+    write(static_cast<uint8_t>(dataIn));
     break;
 
   case 2: /* Half-word */
-    bus.writeHalfWord(addr, static_cast<uint16_t>(dataIn));
+    write(static_cast<uint16_t>(dataIn));
     break;
 
   case 4: /* Word */
-    bus.writeWord(addr, static_cast<uint32_t>(dataIn));
+    write(static_cast<uint32_t>(dataIn));
     break;
 
   case 8: /* Double-word */
-    bus.writeDoubleWord(addr, dataIn);
+    write(dataIn);
     break;
 
   default:
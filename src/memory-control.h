@@ -23,12 +23,16 @@ private:
 
   uint8_t size;
   MemAddress addr;
+
+  /* Host memory of the region instructions were last fetched from */
+  mutable DirectMemoryRange direct{};
 };
 
 class DataMemory {
 public:
   DataMemory(MemoryBus& bus);
 
+  void setPC(MemAddress PC);
   void setSize(uint8_t size);
   void setAddress(MemAddress addr);
   void setDataIn(RegValue value);
@@ -37,6 +41,11 @@ public:
 
   RegValue getDataOut(bool signExtend) const;
 
+  /* Whether the configured access goes to a device rather than RAM,
+   * such that it may have side effects.
+   */
+  bool isDeviceAccess() const { return !lookupDirect(); }
+
   void clockPulse() const;
 
 private:
@@ -47,6 +56,16 @@ private:
   RegValue dataIn{};
   bool readEnable{};
   bool writeEnable{};
+
+  /* Host memory of the region that was last accessed */
+  mutable DirectMemoryRange direct{};
+
+  bool lookupDirect() const;
+
+  template <typename T>
+  T read() const;
+  template <typename T>
+  void write(T value) const;
 };
 
 #endif /* __MEMORY_CONTROL_H__ */
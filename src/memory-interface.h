@@ -16,6 +16,45 @@
 #include <string>
 
 #include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* An address range to which a memory bus client responds. */
+struct MemoryRegion {
+  MemAddress base{};
+  size_t size{};
+};
+
+/* A range of guest memory that is backed by host memory, which may be
+ * accessed directly instead of through the MemoryInterface methods.
+ * The range always permits reads.
+ */
+struct DirectMemoryRange {
+  MemAddress base{};
+  size_t size{};
+  std::byte* data{};
+  bool mayWrite{};
+  bool mayExecute{};
+
+  bool covers(MemAddress addr, size_t accessSize) const
+  {
+    return addr - base < size && accessSize <= size - (addr - base);
+  }
+
+  template <typename T>
+  T read(MemAddress addr) const
+  {
+    T value;
+    std::memcpy(&value, data + (addr - base), sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  void write(MemAddress addr, T value) const
+  {
+    std::memcpy(data + (addr - base), &value, sizeof(T));
+  }
+};
 
 class MemoryInterface {
 public:
@@ -31,6 +70,20 @@ public:
 
   virtual bool contains(MemAddress addr) const = 0;
 
+  /* The address ranges covered by this client, used by the memory bus
+   * to decode addresses. Accesses within a region that are not
+   * supported must still be rejected by the client.
+   */
+  virtual std::vector<MemoryRegion> getRegions() const = 0;
+
+  /* Describe the host memory backing addr, if any. Devices with side
+   * effects on access do not provide direct access.
+   */
+  virtual bool getDirectMemoryRange(MemAddress addr, DirectMemoryRange& range)
+  {
+    return false;
+  }
+
   virtual void clockPulse() {}
 
   virtual ~MemoryInterface() = default;
@@ -8,25 +8,102 @@
 #include "memory.h"
 
 #include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 
 #ifdef _MSC_VER
+#include <windows.h>
+
 #define __builtin_bswap64 _byteswap_uint64
 #define __builtin_bswap32 _byteswap_ulong
 #define __builtin_bswap16 _byteswap_ushort
+#else
+#include <sys/mman.h>
 #endif
 
 Memory::Memory(const std::string& name, std::byte* const data,
                const MemAddress base, const size_t size, const size_t align)
-    : name(name), base(base), size(size), align(align), data(data)
+    : Memory(name, data, base, size, align, Backing::Allocation, nullptr, 0)
+{
+}
+
+Memory::Memory(const std::string& name, std::byte* const data,
+               const MemAddress base, const size_t size, const size_t align,
+               Backing backing, void* mapping, size_t mappingSize)
+    : name(name), base(base), size(size), align(align), data(data),
+      backing(backing), mapping(mapping), mappingSize(mappingSize)
 {
 }
 
 Memory::~Memory()
 {
-  /* Memory was allocated with alignment and nothrow, so we must
-   * also deallocate this way.
+  switch (backing) {
+  case Backing::Anonymous:
+#ifdef _MSC_VER
+    VirtualFree(mapping, 0, MEM_RELEASE);
+#else
+    munmap(mapping, mappingSize);
+#endif
+    break;
+
+  case Backing::File:
+#ifdef _MSC_VER
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, mappingSize);
+#endif
+    break;
+
+  case Backing::Allocation:
+    /* Memory was allocated with alignment and nothrow, so we must
+     * also deallocate this way.
+     */
+    operator delete[](data, std::align_val_t{align}, std::nothrow);
+    break;
+  }
+}
+
+std::unique_ptr<Memory>
+Memory::createZeroed(const std::string& name, MemAddress base, size_t size)
+{
+  if (size == 0)
+    throw std::invalid_argument("Cannot create an empty memory.");
+
+#ifdef _MSC_VER
+  /* Unlike the MAP_NORESERVE mapping below, the whole region is charged
+   * against the commit limit up front, so a large -m needs as much page
+   * file space. Physical pages are still only backed once they are
+   * touched. Committing on first touch would need an exception handler,
+   * as host code accesses guest memory directly.
    */
-  operator delete[](data, std::align_val_t{align}, std::nothrow);
+  void* data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT,
+                            PAGE_READWRITE);
+  if (!data)
+    throw std::runtime_error("Could not allocate memory for " + name + ".");
+#else
+  void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (data == MAP_FAILED)
+    throw std::runtime_error("Could not allocate memory for " + name + ".");
+#endif
+
+  /* Mappings are page aligned, which satisfies any section alignment */
+  return std::unique_ptr<Memory>(
+      new Memory(name, static_cast<std::byte*>(data), base, size, 0,
+                 Backing::Anonymous, data, size));
+}
+
+std::unique_ptr<Memory>
+Memory::createFromFileMapping(const std::string& name, void* mapping,
+                              size_t mappingSize, size_t offset,
+                              MemAddress base, size_t size)
+{
+  if (offset + size > mappingSize)
+    throw std::invalid_argument("Memory does not fit in the mapping.");
+
+  return std::unique_ptr<Memory>(
+      new Memory(name, static_cast<std::byte*>(mapping) + offset, base, size,
+                 0, Backing::File, mapping, mappingSize));
 }
 
 void
@@ -35,6 +112,21 @@ Memory::setMayWrite(bool setting)
   mayWrite = setting;
 }
 
+void
+Memory::setMayExecute(bool setting)
+{
+  mayExecute = setting;
+}
+
+void
+Memory::initialize(MemAddress addr, const std::byte* src, size_t count)
+{
+  if (!canAccess(addr, count, false))
+    throw IllegalAccess(addr, count);
+
+  std::memcpy(data + (addr - base), src, count);
+}
+
 /*
  * MemoryInterface
  */
@@ -116,6 +208,26 @@ Memory::contains(MemAddress addr) const
   return base <= addr && addr < base + size;
 }
 
+std::vector<MemoryRegion>
+Memory::getRegions() const
+{
+  return {{base, size}};
+}
+
+bool
+Memory::getDirectMemoryRange(MemAddress addr, DirectMemoryRange& range)
+{
+  if (!contains(addr))
+    return false;
+
+  range.base = base;
+  range.size = size;
+  range.data = data;
+  range.mayWrite = mayWrite;
+  range.mayExecute = mayExecute;
+  return true;
+}
+
 /*
  * Private methods
  */
@@ -20,7 +20,29 @@ public:
          const size_t size, const size_t align);
   ~Memory() override;
 
+  /* Create a memory that initially reads as zero. Its host memory is an
+   * anonymous mapping, so the host only allocates a page when it is
+   * first written and untouched pages share the host's zero page.
+   */
+  static std::unique_ptr<Memory> createZeroed(const std::string& name,
+                                              MemAddress base, size_t size);
+
+  /* Create a memory on top of a mapping of a file, of which ownership
+   * is transferred to the new object. The memory's contents start at
+   * offset bytes into the mapping of mappingSize bytes.
+   */
+  static std::unique_ptr<Memory>
+  createFromFileMapping(const std::string& name, void* mapping,
+                        size_t mappingSize, size_t offset, MemAddress base,
+                        size_t size);
+
   void setMayWrite(bool setting);
+  void setMayExecute(bool setting);
+
+  /* Copy the initial contents of part of the memory, regardless of
+   * whether it may be written.
+   */
+  void initialize(MemAddress addr, const std::byte* src, size_t count);
 
   /* MemoryInterface */
   uint8_t readByte(MemAddress addr) override;
@@ -34,6 +56,9 @@ public:
   void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
   bool contains(MemAddress addr) const override;
+  std::vector<MemoryRegion> getRegions() const override;
+  bool getDirectMemoryRange(MemAddress addr,
+                            DirectMemoryRange& range) override;
 
   Memory(const Memory&) = delete;
   Memory& operator=(const Memory&) = delete;
@@ -41,10 +66,11 @@ public:
 private:
   const std::string name;
 
-  /* Assume memory may always be read. Do not maintain
-   * separate execute bit.
+  /* Assume memory may always be read. Instructions may only be
+   * fetched from executable memory.
    */
   bool mayWrite = false;
+  bool mayExecute = false;
 
   const MemAddress base;
   const size_t size;
@@ -56,6 +82,19 @@ private:
    */
   std::byte* const data;
 
+  /* How data was obtained, which determines how it is released. */
+  enum class Backing { Allocation, Anonymous, File };
+
+  const Backing backing;
+
+  /* The mapping that contains data, for mapped memories. */
+  void* const mapping;
+  const size_t mappingSize;
+
+  Memory(const std::string& name, std::byte* data, const MemAddress base,
+         const size_t size, const size_t align, Backing backing,
+         void* mapping, size_t mappingSize);
+
   /* Private helper methods */
   bool canAccess(MemAddress addr, size_t accessSize, bool write) const;
 
@@ -0,0 +1,737 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    ooo-core.cc - Out-of-order core model with register renaming
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "ooo-core.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+bool
+instructionUsesRS1(Opcode opcode)
+{
+  switch (opcode) {
+  case Opcode::LUI:
+  case Opcode::AUIPC:
+  case Opcode::JAL:
+    return false;
+  default:
+    return true;
+  }
+}
+
+bool
+evaluateBranch(uint8_t funct3, RegValue lhs, RegValue rhs)
+{
+  switch (funct3) {
+  case 0x0: /* BEQ */
+    return lhs == rhs;
+  case 0x1: /* BNE */
+    return lhs != rhs;
+  case 0x4: /* BLT */
+    return static_cast<int64_t>(lhs) < static_cast<int64_t>(rhs);
+  case 0x5: /* BGE */
+    return static_cast<int64_t>(lhs) >= static_cast<int64_t>(rhs);
+  case 0x6: /* BLTU */
+    return lhs < rhs;
+  case 0x7: /* BGEU */
+    return lhs >= rhs;
+  default:
+    return false;
+  }
+}
+
+/* Truncate and extend a forwarded store value like DataMemory does
+ * for values read from memory.
+ */
+RegValue
+extendLoadValue(RegValue value, uint8_t size, bool signExtend)
+{
+  switch (size) {
+  case 1:
+    return signExtend ? static_cast<int64_t>(static_cast<int8_t>(value))
+                      : static_cast<uint8_t>(value);
+  case 2:
+    return signExtend ? static_cast<int64_t>(static_cast<int16_t>(value))
+                      : static_cast<uint16_t>(value);
+  case 4:
+    return signExtend ? static_cast<int64_t>(static_cast<int32_t>(value))
+                      : static_cast<uint32_t>(value);
+  default:
+    return value;
+  }
+}
+
+bool
+accessesOverlap(MemAddress a, uint8_t sizeA, MemAddress b, uint8_t sizeB)
+{
+  return a < b + sizeB && b < a + sizeA;
+}
+
+} // namespace
+
+/*
+ * OoOConfig
+ */
+
+OoOConfig::OoOConfig(std::string_view spec)
+{
+  while (!spec.empty()) {
+    size_t comma = spec.find(',');
+    std::string_view item = spec.substr(0, comma);
+    spec = comma == std::string_view::npos ? std::string_view{}
+                                           : spec.substr(comma + 1);
+
+    size_t equals = item.find('=');
+    if (equals == std::string_view::npos)
+      throw std::invalid_argument("malformed out-of-order setting " +
+                                  std::string{item});
+
+    std::string key{item.substr(0, equals)};
+    size_t value = std::stoul(std::string{item.substr(equals + 1)});
+
+    if (key == "width")
+      width = value;
+    else if (key == "rob")
+      robSize = value;
+    else if (key == "iq")
+      iqSize = value;
+    else if (key == "lsq")
+      lsqSize = value;
+    else if (key == "prf")
+      physRegs = value;
+    else if (key == "loadlat")
+      loadLatency = value;
+    else
+      throw std::invalid_argument("unknown out-of-order setting " + key);
+  }
+}
+
+void
+OoOConfig::validate() const
+{
+  if (width == 0 || robSize == 0 || iqSize == 0 || lsqSize == 0 ||
+      loadLatency == 0)
+    throw std::out_of_range("out-of-order structure sizes must be non-zero");
+
+  /* Every architectural register needs a mapping plus at least one
+   * register to rename to.
+   */
+  if (physRegs <= NumRegs || physRegs > UINT16_MAX)
+    throw std::out_of_range("number of physical registers must be between " +
+                            std::to_string(NumRegs + 1) + " and " +
+                            std::to_string(UINT16_MAX));
+}
+
+/*
+ * OutOfOrderCore
+ */
+
+OutOfOrderCore::OutOfOrderCore(const OoOConfig& config, bool debugMode,
+                               MemAddress& PC,
+                               InstructionMemory& instructionMemory,
+                               InstructionDecoder& decoder,
+                               RegisterFile& regfile, DataMemory& dataMemory,
+                               CSRFile& csrFile, SyscallEmulator& syscalls,
+                               const SymbolTable* symbols)
+    : config{config}, debugMode{debugMode}, PC{PC},
+      instructionMemory{instructionMemory}, decoder{decoder},
+      regfile{regfile}, dataMemory{dataMemory}, csrFile{csrFile},
+      syscalls{syscalls}, symbols{symbols}
+{
+  config.validate();
+
+  rob.resize(config.robSize);
+  issueQueue.reserve(config.iqSize);
+  alus.resize(config.width);
+  physValues.resize(config.physRegs);
+  physReady.resize(config.physRegs);
+}
+
+/* The architectural registers may still be initialized (from the command
+ * line or a unit test) after construction, so the identity mapping onto
+ * the physical register file is only set up at the first clock cycle.
+ */
+void
+OutOfOrderCore::initialize()
+{
+  for (size_t i = 0; i < NumRegs; ++i) {
+    regfile.setRS1(i);
+    renameMap[i] = i;
+    physValues[i] = regfile.getReadData1();
+    physReady[i] = true;
+  }
+
+  for (size_t i = NumRegs; i < config.physRegs; ++i)
+    freeList.push_back(i);
+
+  initialized = true;
+}
+
+void
+OutOfOrderCore::recordHalt()
+{
+  if (nInstrCompleted > 0)
+    --nInstrCompleted;
+}
+
+/* All stages are evaluated once per clock cycle, in reverse pipeline
+ * order. This way every stage sees the state its predecessor latched in
+ * the previous cycle, which is equivalent to having pipeline registers
+ * between the stages.
+ */
+void
+OutOfOrderCore::clockPulse()
+{
+  if (!initialized)
+    initialize();
+
+  if (profiler)
+    profiler->recordCycle();
+
+  retire();
+  complete();
+  issue();
+  rename();
+  fetch();
+
+  ++cycle;
+}
+
+/*
+ * Retire: commit completed instructions in program order.
+ */
+
+void
+OutOfOrderCore::retire()
+{
+  for (size_t n = 0; n < config.width && robCount > 0; ++n) {
+    ROBEntry& entry = rob[robHead];
+    if (!entry.done) {
+      if (profiler && n == 0)
+        profiler->recordStall(entry.PC);
+      break;
+    }
+
+    if (entry.fault) {
+      PC = entry.PC;
+      std::rethrow_exception(entry.fault);
+    }
+
+    if (debugMode) {
+      auto storeFlags(std::cerr.flags());
+
+      std::cerr << std::hex << std::showbase << entry.PC;
+      if (symbols && symbols->lookup(entry.PC))
+        std::cerr << " <" << symbols->format(entry.PC) << ">";
+      std::cerr << "\t";
+      std::cerr.setf(storeFlags);
+
+      decoder.setInstructionWord(entry.instructionWord);
+      std::cerr << decoder << std::endl;
+    }
+
+    const bool isSyscall = entry.control.getSyscall();
+    if (isSyscall) {
+      try {
+        executeSyscall(entry);
+      } catch (std::exception&) {
+        PC = entry.PC;
+        throw;
+      }
+
+      squashAfter(robHead);
+      fetchQueue.clear();
+      fetchStopped = false;
+      PC = entry.PC + 4;
+    }
+
+    bool isStore = entry.control.getMemWrite();
+    if (isStore) {
+      try {
+        dataMemory.setPC(entry.PC);
+        dataMemory.setAddress(entry.memAddress);
+        dataMemory.setSize(entry.control.getMemSize());
+        dataMemory.setDataIn(entry.storeData);
+        dataMemory.setReadEnable(false);
+        dataMemory.setWriteEnable(true);
+        dataMemory.clockPulse();
+        dataMemory.setWriteEnable(false);
+      } catch (std::exception&) {
+        PC = entry.PC;
+        throw;
+      }
+    }
+
+    if (entry.writesRD) {
+      regfile.setRD(entry.rd);
+      regfile.setWriteData(physValues[entry.prd]);
+      regfile.setWriteEnable(true);
+      regfile.clockPulse();
+      regfile.setWriteEnable(false);
+
+      freeList.push_back(entry.oldPrd);
+    }
+
+    if (entry.control.getMemRead() || isStore)
+      loadStoreQueue.pop_front();
+
+    if (tracer || cosim) {
+      const TraceRecord record = makeRetireRecord(entry);
+      if (tracer)
+        tracer->record(record);
+      if (cosim)
+        cosim->retire(record);
+    }
+
+    if (profiler) {
+      profiler->recordRetire(entry.PC);
+      if (entry.nextPC != entry.PC + 4)
+        profiler->recordTakenBranch(entry.PC);
+    }
+
+    robHead = (robHead + 1) % rob.size();
+    --robCount;
+    ++nInstrCompleted;
+
+    /* There is a single store port to memory. Stopping after a store
+     * also ensures a halt request is honoured before younger
+     * instructions are committed. After a system call, which may have
+     * exited the program, the front-end restarts.
+     */
+    if (isStore || isSyscall)
+      break;
+  }
+}
+
+TraceRecord
+OutOfOrderCore::makeRetireRecord(const ROBEntry& entry) const
+{
+  TraceRecord record;
+  record.PC = entry.PC;
+  record.instructionWord = entry.instructionWord;
+
+  if (entry.writesRD) {
+    record.writesRD = true;
+    record.rd = entry.rd;
+    record.rdValue = physValues[entry.prd];
+  }
+
+  if (entry.control.getMemRead() || entry.control.getMemWrite()) {
+    const bool isLoad = entry.control.getMemRead();
+    record.access =
+        isLoad ? TraceRecord::Access::Load : TraceRecord::Access::Store;
+    record.size = entry.control.getMemSize();
+    record.address = entry.memAddress;
+    record.data = isLoad ? entry.result : entry.storeData;
+  }
+
+  return record;
+}
+
+/*
+ * Complete: make results of finished instructions visible and resolve
+ * control flow.
+ */
+
+void
+OutOfOrderCore::complete()
+{
+  for (size_t offset = 0; offset < robCount; ++offset) {
+    size_t index = robIndex(offset);
+    ROBEntry& entry = rob[index];
+
+    if (!entry.issued || entry.done || entry.completeCycle > cycle)
+      continue;
+
+    entry.done = true;
+    if (entry.writesRD) {
+      physValues[entry.prd] = entry.result;
+      physReady[entry.prd] = true;
+    }
+
+    if (!entry.fault && entry.nextPC != entry.predictedPC) {
+      ++nMispredictions;
+      squashAfter(index);
+
+      fetchQueue.clear();
+      fetchStopped = false;
+      PC = entry.nextPC;
+      break;
+    }
+  }
+}
+
+/* Remove all instructions younger than the instruction at robIndex and
+ * restore the rename map to the state just after that instruction was
+ * renamed. We walk from the youngest instruction backwards, so each
+ * mapping is restored to the previous one in program order.
+ */
+void
+OutOfOrderCore::squashAfter(size_t index)
+{
+  const uint64_t seq = rob[index].seq;
+  const size_t keep = (index + rob.size() - robHead) % rob.size() + 1;
+
+  for (size_t offset = robCount; offset-- > keep;) {
+    ROBEntry& entry = rob[robIndex(offset)];
+
+    if (entry.writesRD) {
+      renameMap[entry.rd] = entry.oldPrd;
+      freeList.push_back(entry.prd);
+    }
+
+    if (!entry.fault)
+      ++nInstrSquashed;
+  }
+  robCount = keep;
+
+  auto isYounger = [this, seq](size_t i) { return rob[i].seq > seq; };
+  issueQueue.erase(
+      std::remove_if(issueQueue.begin(), issueQueue.end(), isYounger),
+      issueQueue.end());
+  loadStoreQueue.erase(std::remove_if(loadStoreQueue.begin(),
+                                      loadStoreQueue.end(), isYounger),
+                       loadStoreQueue.end());
+}
+
+/*
+ * Issue: select the oldest instructions with available operands.
+ */
+
+void
+OutOfOrderCore::issue()
+{
+  size_t slot = 0;
+
+  for (auto it = issueQueue.begin();
+       it != issueQueue.end() && slot < config.width;) {
+    ROBEntry& entry = rob[*it];
+
+    if (physReady[entry.prs1] && physReady[entry.prs2] &&
+        execute(entry, alus[slot])) {
+      it = issueQueue.erase(it);
+      ++slot;
+    } else
+      ++it;
+  }
+}
+
+/* Execute an instruction whose operands are available. Returns false if
+ * the instruction cannot execute yet, which is only the case for loads
+ * that depend on an older store and for device loads and CSR
+ * instructions that are not the oldest instruction.
+ */
+bool
+OutOfOrderCore::execute(ROBEntry& entry, ALU& alu)
+{
+  if (entry.control.getMemRead())
+    return executeLoad(entry);
+  if (entry.control.getCSR())
+    return executeCSR(entry);
+
+  RegValue rs1Value = physValues[entry.prs1];
+  RegValue rs2Value = physValues[entry.prs2];
+
+  RegValue operandA = rs1Value;
+  if (entry.opcode == Opcode::AUIPC)
+    operandA = entry.PC;
+  else if (entry.opcode == Opcode::LUI)
+    operandA = 0;
+
+  RegValue operandB = entry.control.getALUSrc()
+                          ? static_cast<RegValue>(entry.immediate)
+                          : rs2Value;
+
+  alu.setA(operandA);
+  alu.setB(operandB);
+  alu.setOp(entry.control.getALUOp());
+  entry.result = alu.getResult();
+
+  entry.nextPC = entry.PC + 4;
+
+  if (entry.control.getBranch() &&
+      evaluateBranch(entry.funct3, rs1Value, rs2Value))
+    entry.nextPC = entry.PC + entry.immediate;
+
+  if (entry.control.getJump()) {
+    entry.result = entry.PC + 4;
+
+    if (entry.opcode == Opcode::JAL)
+      entry.nextPC = entry.PC + entry.immediate;
+    else
+      entry.nextPC = (rs1Value + entry.immediate) & ~static_cast<uint64_t>(1);
+  }
+
+  if (entry.control.getMemWrite()) {
+    entry.memAddress = entry.result;
+    entry.storeData = rs2Value;
+    entry.addressReady = true;
+  }
+
+  entry.issued = true;
+  entry.completeCycle = cycle + 1;
+  return true;
+}
+
+/* A load may only execute once the addresses of all older stores are
+ * known. If the youngest older store to an overlapping address writes
+ * exactly the same bytes, its data is forwarded; any other overlap
+ * makes the load wait until that store has been retired.
+ */
+bool
+OutOfOrderCore::executeLoad(ROBEntry& entry)
+{
+  const uint8_t size = entry.control.getMemSize();
+
+  entry.memAddress = physValues[entry.prs1] + entry.immediate;
+  entry.addressReady = true;
+  entry.nextPC = entry.PC + 4;
+
+  const ROBEntry* match = nullptr;
+  for (size_t index : loadStoreQueue) {
+    const ROBEntry& older = rob[index];
+    if (older.seq >= entry.seq)
+      break;
+    if (!older.control.getMemWrite())
+      continue;
+    if (!older.addressReady)
+      return false;
+
+    if (accessesOverlap(older.memAddress, older.control.getMemSize(),
+                        entry.memAddress, size))
+      match = &older;
+  }
+
+  if (match) {
+    if (match->memAddress != entry.memAddress ||
+        match->control.getMemSize() != size)
+      return false;
+
+    entry.result = extendLoadValue(match->storeData, size,
+                                   entry.control.getMemSignExtend());
+    ++nLoadsForwarded;
+  } else {
+    /* Device reads may have side effects, such as consuming received
+     * input, so these are not executed speculatively.
+     */
+    dataMemory.setAddress(entry.memAddress);
+    dataMemory.setSize(size);
+    if (&entry != &rob[robHead] && dataMemory.isDeviceAccess())
+      return false;
+
+    try {
+      dataMemory.setPC(entry.PC);
+      dataMemory.setWriteEnable(false);
+      dataMemory.setReadEnable(true);
+      entry.result = dataMemory.getDataOut(entry.control.getMemSignExtend());
+      dataMemory.setReadEnable(false);
+    } catch (std::exception&) {
+      /* Only raised when the load turns out to be non-speculative. */
+      dataMemory.setReadEnable(false);
+      entry.fault = std::current_exception();
+      entry.result = 0;
+    }
+  }
+
+  entry.issued = true;
+  entry.completeCycle = cycle + config.loadLatency;
+  return true;
+}
+
+/* CSR writes cannot be undone when the instruction is squashed, so CSR
+ * instructions wait until no older instruction can mispredict.
+ */
+bool
+OutOfOrderCore::executeCSR(ROBEntry& entry)
+{
+  if (&entry != &rob[robHead])
+    return false;
+
+  decoder.setInstructionWord(entry.instructionWord);
+  const RegNumber rs1 = decoder.getRS1();
+  const uint16_t csr = decoder.getCSR();
+  const RegValue operand =
+      entry.funct3 & 0x4 ? rs1 : physValues[entry.prs1];
+
+  try {
+    entry.result = csrFile.read(csr);
+    if (CSRFile::writesCSR(entry.funct3, rs1))
+      csrFile.write(csr, CSRFile::applyOperation(entry.funct3, entry.result,
+                                                 operand));
+  } catch (std::exception&) {
+    entry.fault = std::current_exception();
+    entry.result = 0;
+  }
+
+  entry.nextPC = entry.PC + 4;
+  entry.issued = true;
+  entry.completeCycle = cycle + 1;
+  return true;
+}
+
+/* All older instructions have retired, so the arguments are read from
+ * the architectural registers.
+ */
+void
+OutOfOrderCore::executeSyscall(ROBEntry& entry)
+{
+  SyscallArguments args;
+  for (size_t i = 0; i < args.size(); ++i) {
+    regfile.setRS1(SyscallFirstArgument + i);
+    args[i] = regfile.getReadData1();
+  }
+
+  physValues[entry.prd] = syscalls.execute(args);
+  physReady[entry.prd] = true;
+}
+
+/*
+ * Rename: decode, allocate resources and rename registers.
+ */
+
+void
+OutOfOrderCore::rename()
+{
+  for (size_t n = 0; n < config.width && !fetchQueue.empty(); ++n) {
+    const FetchEntry& fetched = fetchQueue.front();
+
+    if (robCount == rob.size()) {
+      ++nRenameStalls;
+      break;
+    }
+
+    ROBEntry entry{};
+    entry.seq = nextSeq;
+    entry.PC = fetched.PC;
+    entry.instructionWord = fetched.instructionWord;
+    entry.predictedPC = fetched.predictedPC;
+    entry.fault = fetched.fault;
+
+    if (!entry.fault) {
+      decoder.setInstructionWord(fetched.instructionWord);
+      try {
+        entry.immediate = decoder.getImmediate();
+        if (decoder.getOpcode() == Opcode::SYSTEM &&
+            (decoder.getFunct3() & 0x3) == 0 &&
+            fetched.instructionWord != EcallInstruction)
+          throw IllegalInstruction("Unsupported system instruction");
+      } catch (IllegalInstruction&) {
+        entry.fault = std::current_exception();
+      }
+    }
+
+    /* Faulting instructions are not executed, but are kept in the
+     * reorder buffer until they reach the head.
+     */
+    if (entry.fault) {
+      entry.done = true;
+      rob[robIndex(robCount)] = entry;
+      ++robCount;
+      ++nextSeq;
+      fetchQueue.pop_front();
+      continue;
+    }
+
+    entry.opcode = decoder.getOpcode();
+    entry.funct3 = decoder.getFunct3();
+    entry.rd = destinationRegister(decoder);
+    entry.control.setFromInstruction(decoder);
+    entry.writesRD = entry.control.getRegWrite() && entry.rd != 0;
+
+    bool isMem = entry.control.getMemRead() || entry.control.getMemWrite();
+
+    if (issueQueue.size() >= config.iqSize ||
+        (isMem && loadStoreQueue.size() >= config.lsqSize) ||
+        (entry.writesRD && freeList.empty())) {
+      ++nRenameStalls;
+      break;
+    }
+
+    entry.prs1 = instructionUsesRS1(entry.opcode)
+                     ? renameMap[decoder.getRS1()]
+                     : renameMap[0];
+    entry.prs2 = instructionUsesRS2(entry.opcode)
+                     ? renameMap[decoder.getRS2()]
+                     : renameMap[0];
+
+    if (entry.writesRD) {
+      entry.prd = freeList.front();
+      freeList.pop_front();
+      entry.oldPrd = renameMap[entry.rd];
+      renameMap[entry.rd] = entry.prd;
+      physReady[entry.prd] = false;
+    }
+
+    size_t index = robIndex(robCount);
+    rob[index] = entry;
+    ++robCount;
+    ++nextSeq;
+
+    /* System calls do not pass through the issue queue */
+    if (entry.control.getSyscall()) {
+      rob[index].nextPC = entry.PC + 4;
+      rob[index].done = true;
+    } else
+      issueQueue.push_back(index);
+    if (isMem)
+      loadStoreQueue.push_back(index);
+
+    ++nInstrIssued;
+    fetchQueue.pop_front();
+  }
+}
+
+/*
+ * Fetch: read instructions sequentially, following JAL targets.
+ */
+
+void
+OutOfOrderCore::fetch()
+{
+  if (fetchStopped)
+    return;
+
+  const size_t capacity = 2 * config.width;
+
+  for (size_t n = 0; n < config.width && fetchQueue.size() < capacity; ++n) {
+    FetchEntry fetched{};
+    fetched.PC = PC;
+
+    try {
+      instructionMemory.setAddress(PC);
+      instructionMemory.setSize(4);
+      fetched.instructionWord = instructionMemory.getValue();
+    } catch (std::exception&) {
+      fetched.fault = std::make_exception_ptr(InstructionFetchFailure(PC));
+    }
+
+    if (!fetched.fault && fetched.instructionWord == TestEndMarker)
+      fetched.fault = std::make_exception_ptr(TestEndMarkerEncountered(PC));
+
+    /* Nothing beyond a faulting instruction is fetched, until a
+     * misprediction redirects the front-end.
+     */
+    if (fetched.fault) {
+      fetchQueue.push_back(fetched);
+      fetchStopped = true;
+      return;
+    }
+
+    decoder.setInstructionWord(fetched.instructionWord);
+    bool isJAL = decoder.getOpcode() == Opcode::JAL;
+
+    fetched.predictedPC = isJAL ? PC + decoder.getImmediateJ() : PC + 4;
+    fetchQueue.push_back(fetched);
+    PC = fetched.predictedPC;
+
+    /* A taken jump ends the fetch group. */
+    if (isJAL)
+      break;
+  }
+}
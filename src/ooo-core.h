@@ -0,0 +1,210 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    ooo-core.h - Out-of-order core model with register renaming
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __OOO_CORE_H__
+#define __OOO_CORE_H__
+
+#include "stages.h"
+
+#include "cosim.h"
+#include "memory-control.h"
+#include "profiler.h"
+#include "trace.h"
+
+#include <array>
+#include <deque>
+#include <exception>
+#include <string_view>
+#include <vector>
+
+/* Sizes of the out-of-order structures. These can be set from the
+ * command line with a specification of the form "key=value,key=value",
+ * for instance "width=2,rob=32". Keys that are not specified keep
+ * their default value.
+ */
+struct OoOConfig {
+  OoOConfig() = default;
+  OoOConfig(std::string_view spec);
+
+  size_t width = 4;      /* Fetch, rename, issue and retire width */
+  size_t robSize = 64;   /* Reorder buffer entries */
+  size_t iqSize = 32;    /* Issue queue entries */
+  size_t lsqSize = 16;   /* Load/store queue entries */
+  size_t physRegs = 128; /* Physical registers, including architectural */
+  size_t loadLatency = 2;
+
+  void validate() const;
+};
+
+/* The out-of-order core fetches and renames instructions in program
+ * order, executes them as soon as their operands are available and
+ * retires them in program order from the reorder buffer. Only at
+ * retirement the architectural RegisterFile is updated and stores are
+ * sent to memory, such that exceptions (fetch failures, illegal
+ * instructions, invalid accesses and the test end marker) are raised
+ * precisely. CSR instructions execute when they are the oldest
+ * instruction. System calls are executed at retirement, after which
+ * all younger instructions are squashed because they may have read
+ * memory or registers that the system call changed.
+ *
+ * Control flow is predicted statically: conditional branches are
+ * predicted not-taken, JAL is redirected during fetch. Mispredictions
+ * are detected when the branch completes, after which all younger
+ * instructions are squashed.
+ */
+class OutOfOrderCore {
+public:
+  OutOfOrderCore(const OoOConfig& config, bool debugMode, MemAddress& PC,
+                 InstructionMemory& instructionMemory,
+                 InstructionDecoder& decoder, RegisterFile& regfile,
+                 DataMemory& dataMemory, CSRFile& csrFile,
+                 SyscallEmulator& syscalls,
+                 const SymbolTable* symbols = nullptr);
+
+  OutOfOrderCore(const OutOfOrderCore&) = delete;
+  OutOfOrderCore& operator=(const OutOfOrderCore&) = delete;
+
+  void clockPulse();
+
+  /* The store that requested a halt or the system call that exited was
+   * the last instruction to retire. The in-order pipeline stops before
+   * such an instruction reaches write back, so it is not counted as
+   * completed here either.
+   */
+  void recordHalt();
+
+  void setProfiler(Profiler* profiler) { this->profiler = profiler; }
+  void setTracer(TraceWriter* tracer) { this->tracer = tracer; }
+  void setCoSimulator(CoSimulator* cosim) { this->cosim = cosim; }
+
+  const OoOConfig& getConfig() const { return config; }
+
+  uint64_t getInstrIssued() const { return nInstrIssued; }
+  uint64_t getInstrCompleted() const { return nInstrCompleted; }
+  uint64_t getInstrSquashed() const { return nInstrSquashed; }
+  uint64_t getMispredictions() const { return nMispredictions; }
+  uint64_t getLoadsForwarded() const { return nLoadsForwarded; }
+  uint64_t getRenameStalls() const { return nRenameStalls; }
+
+private:
+  using PhysReg = uint16_t;
+
+  struct FetchEntry {
+    MemAddress PC{};
+    uint32_t instructionWord{};
+    MemAddress predictedPC{};
+    std::exception_ptr fault{};
+  };
+
+  struct ROBEntry {
+    uint64_t seq{};
+    MemAddress PC{};
+    uint32_t instructionWord{};
+    MemAddress predictedPC{};
+
+    Opcode opcode{Opcode::OP};
+    uint8_t funct3{};
+    int64_t immediate{};
+    ControlSignals control{};
+
+    RegNumber rd{};
+    bool writesRD{};
+    PhysReg prd{};
+    PhysReg oldPrd{};
+    PhysReg prs1{};
+    PhysReg prs2{};
+
+    bool issued{};
+    bool done{};
+    uint64_t completeCycle{};
+
+    MemAddress memAddress{};
+    RegValue storeData{};
+    bool addressReady{};
+
+    RegValue result{};
+    MemAddress nextPC{};
+
+    std::exception_ptr fault{};
+  };
+
+  OoOConfig config;
+  bool debugMode;
+
+  MemAddress& PC;
+  InstructionMemory& instructionMemory;
+  InstructionDecoder& decoder;
+  RegisterFile& regfile;
+  DataMemory& dataMemory;
+  CSRFile& csrFile;
+  SyscallEmulator& syscalls;
+  const SymbolTable* symbols; /* no ownership, may be nullptr */
+
+  uint64_t cycle{};
+  uint64_t nextSeq{};
+  bool initialized{};
+  bool fetchStopped{};
+
+  /* Front-end */
+  std::deque<FetchEntry> fetchQueue{};
+
+  /* Renaming */
+  std::array<PhysReg, NumRegs> renameMap{};
+  std::vector<RegValue> physValues{};
+  std::vector<bool> physReady{};
+  std::deque<PhysReg> freeList{};
+
+  /* Reorder buffer, circular */
+  std::vector<ROBEntry> rob{};
+  size_t robHead{};
+  size_t robCount{};
+
+  /* Issue queue and load/store queue, both hold ROB indices in
+   * program order.
+   */
+  std::vector<size_t> issueQueue{};
+  std::deque<size_t> loadStoreQueue{};
+
+  std::vector<ALU> alus{};
+
+  Profiler* profiler{}; /* no ownership */
+  TraceWriter* tracer{}; /* no ownership */
+  CoSimulator* cosim{};  /* no ownership */
+
+  /* Statistics. Issued instructions are either completed, squashed or
+   * still in flight when the program ends, as in the in-order pipeline.
+   * Instructions that fault in fetch or decode are never issued.
+   */
+  uint64_t nInstrIssued{};
+  uint64_t nInstrCompleted{};
+  uint64_t nInstrSquashed{};
+  uint64_t nMispredictions{};
+  uint64_t nLoadsForwarded{};
+  uint64_t nRenameStalls{};
+
+  void initialize();
+
+  void retire();
+  void complete();
+  void issue();
+  void rename();
+  void fetch();
+
+  bool execute(ROBEntry& entry, ALU& alu);
+  bool executeLoad(ROBEntry& entry);
+  bool executeCSR(ROBEntry& entry);
+  void executeSyscall(ROBEntry& entry);
+  void squashAfter(size_t robIndex);
+  TraceRecord makeRetireRecord(const ROBEntry& entry) const;
+
+  size_t robIndex(size_t offset) const
+  {
+    return (robHead + offset) % rob.size();
+  }
+};
+
+#endif /* __OOO_CORE_H__ */
@@ -0,0 +1,36 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    perf-counter.h - Performance counters visible to programs.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __PERF_COUNTER_H__
+#define __PERF_COUNTER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/* The counters of the processor that programs can read, through the
+ * system status registers and the counter CSRs. Stalls are the load-use
+ * stalls of the pipeline or the rename stalls of the out-of-order core.
+ * Control flushes are the redirects of the pipeline or the
+ * mispredictions of the out-of-order core.
+ */
+enum class PerfCounter {
+  Cycles = 0,
+  InstrIssued,
+  InstrCompleted,
+  Stalls,
+  BytesRead,
+  BytesWritten,
+  ControlFlushes
+};
+
+static constexpr size_t NumPerfCounters = 7;
+
+/* Provides the current value of a performance counter. */
+using PerfCounterSource = std::function<uint64_t(PerfCounter)>;
+
+#endif /* __PERF_COUNTER_H__ */
@@ -7,21 +7,51 @@
 
 #include "pipeline.h"
 
+#include <iomanip>
+
+/* Describe the instruction in the write back stage for the trace. */
+static TraceRecord
+makeTraceRecord(const M_WBRegisters& m_wb)
+{
+  TraceRecord record;
+  record.PC = m_wb.PC;
+  record.instructionWord = m_wb.instructionWord;
+
+  if (m_wb.control.getRegWrite() && m_wb.rd != 0) {
+    record.writesRD = true;
+    record.rd = m_wb.rd;
+    record.rdValue =
+        m_wb.control.getMemToReg() ? m_wb.memData : m_wb.aluResult;
+  }
+
+  if (m_wb.control.getMemRead() || m_wb.control.getMemWrite()) {
+    const bool isLoad = m_wb.control.getMemRead();
+    record.access =
+        isLoad ? TraceRecord::Access::Load : TraceRecord::Access::Store;
+    record.size = m_wb.control.getMemSize();
+    record.address = m_wb.aluResult;
+    record.data = isLoad ? m_wb.memData : m_wb.writeData;
+  }
+
+  return record;
+}
+
 Pipeline::Pipeline(bool pipelining, bool debugMode, MemAddress& PC,
                    InstructionMemory& instructionMemory,
                    InstructionDecoder& decoder, RegisterFile& regfile,
-                   DataMemory& dataMemory)
+                   DataMemory& dataMemory, CSRFile& csrFile,
+                   SyscallEmulator& syscalls, const SymbolTable* symbols)
     : pipelining{pipelining}
 {
   stages.emplace_back(std::make_unique<InstructionFetchStage>(
       pipelining, if_id, instructionMemory, PC, controlSignals));
   stages.emplace_back(std::make_unique<InstructionDecodeStage>(
       pipelining, if_id, id_ex, m_wb, regfile, decoder, nInstrIssued, nStalls,
-      controlSignals, debugMode));
-  stages.emplace_back(std::make_unique<ExecuteStage>(pipelining, id_ex, ex_m,
-                                                     m_wb, PC, controlSignals));
-  stages.emplace_back(
-      std::make_unique<MemoryStage>(pipelining, ex_m, m_wb, dataMemory));
+      controlSignals, debugMode, symbols));
+  stages.emplace_back(std::make_unique<ExecuteStage>(
+      pipelining, id_ex, ex_m, m_wb, PC, controlSignals, csrFile));
+  stages.emplace_back(std::make_unique<MemoryStage>(
+      pipelining, ex_m, m_wb, dataMemory, regfile, syscalls));
   stages.emplace_back(std::make_unique<WriteBackStage>(
       pipelining, m_wb, regfile, nInstrCompleted));
 }
@@ -32,12 +62,37 @@ Pipeline::propagate()
   controlSignals.reset();
 
   if (!pipelining) {
-    /* Execute a single instruction execution step. */
+    /* Execute a single instruction execution step. Without pipelining
+     * only the write back step counts towards the base CPI, the other
+     * steps are lost because the stages cannot overlap.
+     */
     stages[currentStage]->propagate();
+
+    currentCategory = currentStage == stages.size() - 1
+                          ? CycleCategory::Base
+                          : CycleCategory::Structural;
+    retiringPC = m_wb.PC;
+    retiringSeq = m_wb.seq;
+    retiringStore = m_wb.control.getMemWrite();
   } else {
     /* Run propagate for all stages within a single clock cycle. */
     for (auto& s : stages)
       s->propagate();
+
+    currentCategory = m_wb.PC != 0x0 ? CycleCategory::Base : m_wb.bubble;
+    retiringPC = m_wb.PC;
+    retiringSeq = m_wb.seq;
+    retiringStore = m_wb.control.getMemWrite();
+  }
+
+  if ((tracer || cosim) && currentCategory == CycleCategory::Base)
+    retiringRecord = makeTraceRecord(m_wb);
+
+  if (profiler) {
+    if (controlSignals.insertDecodeBubble)
+      profiler->recordStall(if_id.PC);
+    if (controlSignals.flushDecode)
+      profiler->recordTakenBranch(id_ex.PC);
   }
 }
 
@@ -50,5 +105,142 @@ Pipeline::clockPulse()
   } else {
     for (auto& s : stages)
       s->clockPulse();
+
+    if (controlSignals.flushDecode)
+      ++nFlushes;
   }
+
+  /* Only account the cycle once all stages completed it, such that the
+   * cycle stack always sums to the cycle count of the Processor.
+   */
+  ++cycleStack[static_cast<size_t>(currentCategory)];
+
+  if (profiler) {
+    profiler->recordCycle();
+    if (currentCategory == CycleCategory::Base)
+      profiler->recordRetire(retiringPC);
+  }
+
+  if (tracer && currentCategory == CycleCategory::Base)
+    tracer->record(retiringRecord);
+
+  if (cosim && currentCategory == CycleCategory::Base)
+    cosim->retire(retiringRecord);
+
+  if (pipeView)
+    updatePipeView();
+
+  ++cycle;
+}
+
+void
+Pipeline::recordHalt()
+{
+  if (m_wb.PC == 0)
+    return;
+
+  const TraceRecord record = makeTraceRecord(m_wb);
+  if (tracer)
+    tracer->record(record);
+  if (cosim)
+    cosim->retire(record);
+}
+
+void
+Pipeline::dumpRegisters(std::ostream& os) const
+{
+  auto storeFlags(os.flags());
+  os << std::hex << std::setfill('0');
+
+  os << "IF/ID   PC " << std::setw(8) << if_id.PC << "  instr "
+     << std::setw(8) << if_id.instructionWord << std::endl;
+  os << "ID/EX   PC " << std::setw(8) << id_ex.PC << "  instr "
+     << std::setw(8) << id_ex.instructionWord << "  rs1 "
+     << std::setw(16) << id_ex.readData1 << "  rs2 " << std::setw(16)
+     << id_ex.readData2 << "  imm " << std::setw(16) << id_ex.immediate
+     << "  rd " << std::dec << static_cast<int>(id_ex.rd) << std::hex
+     << std::endl;
+  os << "EX/M    PC " << std::setw(8) << ex_m.PC << "  instr "
+     << std::setw(8) << ex_m.instructionWord << "  alu " << std::setw(16)
+     << ex_m.aluResult << "  data " << std::setw(16) << ex_m.writeData
+     << "  rd " << std::dec << static_cast<int>(ex_m.rd) << std::hex
+     << std::endl;
+  os << "M/WB    PC " << std::setw(8) << m_wb.PC << "  instr "
+     << std::setw(8) << m_wb.instructionWord << "  alu " << std::setw(16)
+     << m_wb.aluResult << "  mem " << std::setw(16) << m_wb.memData
+     << "  rd " << std::dec << static_cast<int>(m_wb.rd) << std::endl;
+
+  os.flags(storeFlags);
+  os << std::setfill(' ');
+}
+
+/* Log which instructions moved into the next stage during this cycle.
+ * An instruction in a pipeline register at the end of a cycle occupies
+ * the stage after that register from the next cycle on.
+ */
+void
+Pipeline::updatePipeView()
+{
+  if (currentCategory == CycleCategory::Base)
+    pipeView->recordRetire(retiringSeq, cycle, retiringStore);
+
+  pipeView->recordFetch(if_id.seq, if_id.PC, if_id.instructionWord, cycle);
+  pipeView->recordStage(id_ex.seq, PipeViewWriter::Stage::Execute, cycle + 1);
+  pipeView->recordStage(ex_m.seq, PipeViewWriter::Stage::Memory, cycle + 1);
+}
+
+const char*
+getCycleCategoryName(CycleCategory category)
+{
+  switch (category) {
+  case CycleCategory::Base:
+    return "base";
+  case CycleCategory::LoadUse:
+    return "load-use";
+  case CycleCategory::ControlFlush:
+    return "control flush";
+  case CycleCategory::Structural:
+    return "structural";
+  case CycleCategory::Drain:
+    return "drain";
+  case CycleCategory::Memory:
+    return "memory";
+  default:
+    return "unknown";
+  }
+}
+
+/* Print the cycle stack as CPI components, which add up to the CPI
+ * over all completed instructions.
+ */
+void
+dumpCycleStack(std::ostream& os,
+               const std::array<uint64_t, NumCycleCategories>& stack,
+               uint64_t totalCycles, uint64_t instrCompleted)
+{
+  auto storeFlags(os.flags());
+  auto storePrecision(os.precision());
+  auto storeFill(os.fill());
+
+  os << "CPI stack:" << std::setfill(' ') << std::endl;
+  for (size_t i = 0; i < NumCycleCategories; ++i) {
+    os << "  " << std::left << std::setw(14)
+       << getCycleCategoryName(static_cast<CycleCategory>(i)) << std::right
+       << std::setw(10) << stack[i] << " cycles";
+    if (instrCompleted > 0)
+      os << "  CPI " << std::fixed << std::setprecision(3)
+         << static_cast<double>(stack[i]) / instrCompleted;
+    os << std::endl;
+    os.flags(storeFlags);
+  }
+
+  os << "  " << std::left << std::setw(14) << "total" << std::right
+     << std::setw(10) << totalCycles << " cycles";
+  if (instrCompleted > 0)
+    os << "  CPI " << std::fixed << std::setprecision(3)
+       << static_cast<double>(totalCycles) / instrCompleted;
+  os << std::endl;
+  os.flags(storeFlags);
+  os.precision(storePrecision);
+  os.fill(storeFill);
 }
@@ -10,13 +10,21 @@
 
 #include "stages.h"
 
+#include "cosim.h"
 #include "memory-control.h"
+#include "pipeview.h"
+#include "profiler.h"
+#include "trace.h"
+
+#include <array>
+#include <ostream>
 
 class Pipeline {
 public:
   Pipeline(bool pipelining, bool debugMode, MemAddress& PC,
            InstructionMemory& instructionMemory, InstructionDecoder& decoder,
-           RegisterFile& regfile, DataMemory& dataMemory);
+           RegisterFile& regfile, DataMemory& dataMemory, CSRFile& csrFile,
+           SyscallEmulator& syscalls, const SymbolTable* symbols = nullptr);
 
   Pipeline(const Pipeline&) = delete;
   Pipeline& operator=(const Pipeline&) = delete;
@@ -24,6 +32,19 @@ public:
   void propagate();
   void clockPulse();
 
+  void setProfiler(Profiler* profiler) { this->profiler = profiler; }
+  void setTracer(TraceWriter* tracer) { this->tracer = tracer; }
+  void setPipeView(PipeViewWriter* pipeView) { this->pipeView = pipeView; }
+  void setCoSimulator(CoSimulator* cosim) { this->cosim = cosim; }
+
+  /* Trace and check the store that requested a halt or the system call
+   * that exited, which do not reach the write back stage anymore.
+   */
+  void recordHalt();
+
+  /* Print the contents of the pipeline registers */
+  void dumpRegisters(std::ostream& os) const;
+
   bool getPipelining() const { return pipelining; }
 
   uint64_t getInstrIssued() const { return nInstrIssued; }
@@ -32,6 +53,13 @@ public:
 
   uint64_t getStalls() const { return nStalls; }
 
+  uint64_t getFlushes() const { return nFlushes; }
+
+  const std::array<uint64_t, NumCycleCategories>& getCycleStack() const
+  {
+    return cycleStack;
+  }
+
 private:
   bool pipelining;
   size_t currentStage{};
@@ -40,6 +68,21 @@ private:
   uint64_t nInstrIssued{};
   uint64_t nInstrCompleted{};
   uint64_t nStalls{};
+  uint64_t nFlushes{};
+  std::array<uint64_t, NumCycleCategories> cycleStack{};
+  CycleCategory currentCategory{};
+  MemAddress retiringPC{};
+  uint64_t retiringSeq{};
+  bool retiringStore{};
+  uint64_t cycle{};
+
+  Profiler* profiler{}; /* no ownership */
+  TraceWriter* tracer{}; /* no ownership */
+  TraceRecord retiringRecord{};
+  PipeViewWriter* pipeView{}; /* no ownership */
+  CoSimulator* cosim{};        /* no ownership */
+
+  void updatePipeView();
 
   /* Stages */
   std::vector<std::unique_ptr<Stage>> stages{};
@@ -53,4 +96,10 @@ private:
   PipelineControl controlSignals{};
 };
 
+const char* getCycleCategoryName(CycleCategory category);
+
+void dumpCycleStack(std::ostream& os,
+                    const std::array<uint64_t, NumCycleCategories>& stack,
+                    uint64_t totalCycles, uint64_t instrCompleted);
+
 #endif /* __PIPELINE_H__ */
@@ -0,0 +1,112 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    pipeview.cc - Pipeline occupancy trace in the O3PipeView format.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "pipeview.h"
+
+#include "inst-decoder.h"
+
+#include <sstream>
+#include <stdexcept>
+
+PipeViewWriter::PipeViewWriter(const std::string& filename) : file{filename}
+{
+  if (!file)
+    throw std::runtime_error("cannot open pipeline view output file " +
+                             filename);
+}
+
+PipeViewWriter::~PipeViewWriter()
+{
+  /* Instructions still in flight when the program ends never retire. */
+  for (const Entry& entry : inFlight)
+    write(entry, 0, 0);
+}
+
+void
+PipeViewWriter::recordFetch(uint64_t seq, MemAddress PC,
+                            uint32_t instructionWord, uint64_t cycle)
+{
+  if (seq == 0 || (!inFlight.empty() && seq <= inFlight.back().seq))
+    return;
+
+  Entry entry;
+  entry.seq = seq;
+  entry.PC = PC;
+  entry.instructionWord = instructionWord;
+  entry.fetch = toTick(cycle);
+  entry.decode = toTick(cycle + 1);
+  inFlight.push_back(entry);
+}
+
+void
+PipeViewWriter::recordStage(uint64_t seq, Stage stage, uint64_t cycle)
+{
+  Entry* entry = find(seq);
+  if (!entry)
+    return;
+
+  uint64_t& tick = stage == Stage::Execute ? entry->execute : entry->memory;
+  if (tick == 0)
+    tick = toTick(cycle);
+}
+
+void
+PipeViewWriter::recordRetire(uint64_t seq, uint64_t cycle, bool isStore)
+{
+  while (!inFlight.empty() && inFlight.front().seq < seq) {
+    write(inFlight.front(), 0, 0);
+    inFlight.pop_front();
+  }
+
+  if (inFlight.empty() || inFlight.front().seq != seq)
+    return;
+
+  const Entry& entry = inFlight.front();
+  write(entry, toTick(cycle), isStore ? entry.memory : 0);
+  inFlight.pop_front();
+}
+
+PipeViewWriter::Entry*
+PipeViewWriter::find(uint64_t seq)
+{
+  if (seq == 0)
+    return nullptr;
+
+  /* At most a handful of instructions is in flight. */
+  for (Entry& entry : inFlight)
+    if (entry.seq == seq)
+      return &entry;
+
+  return nullptr;
+}
+
+void
+PipeViewWriter::write(const Entry& entry, uint64_t retireTick,
+                      uint64_t storeTick)
+{
+  std::stringstream disassembly;
+  InstructionDecoder decoder;
+  decoder.setInstructionWord(entry.instructionWord);
+  try {
+    disassembly << decoder;
+  } catch (IllegalInstruction&) {
+    disassembly << "illegal instruction";
+  }
+
+  std::stringstream pc;
+  pc << std::hex << "0x" << entry.PC;
+
+  file << "O3PipeView:fetch:" << entry.fetch << ":" << pc.str() << ":0:"
+       << entry.seq << ":" << disassembly.str() << "\n"
+       << "O3PipeView:decode:" << entry.decode << "\n"
+       << "O3PipeView:rename:" << entry.decode << "\n"
+       << "O3PipeView:dispatch:" << entry.decode << "\n"
+       << "O3PipeView:issue:" << entry.execute << "\n"
+       << "O3PipeView:complete:" << entry.memory << "\n"
+       << "O3PipeView:retire:" << retireTick << ":store:" << storeTick
+       << "\n";
+}
@@ -0,0 +1,80 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    pipeview.h - Pipeline occupancy trace in the O3PipeView format.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __PIPEVIEW_H__
+#define __PIPEVIEW_H__
+
+#include "arch.h"
+
+#include <deque>
+#include <fstream>
+#include <string>
+
+/* Writes the cycles in which every fetched instruction entered the
+ * pipeline stages, in the O3PipeView text format of gem5 that can be
+ * visualized with Konata or gem5's o3-pipeview.py. The five stages map
+ * onto the O3 stages as follows: IF is fetch, ID is decode, rename and
+ * dispatch, EX is issue, MEM is complete and WB is retire.
+ *
+ * Only the instructions that are still in flight are kept in memory;
+ * every instruction is written out as soon as it retires or is known
+ * to be squashed. Instructions are identified by the sequence number
+ * assigned at fetch, which increases in fetch order.
+ */
+class PipeViewWriter {
+public:
+  enum class Stage { Execute, Memory };
+
+  PipeViewWriter(const std::string& filename);
+  ~PipeViewWriter();
+
+  PipeViewWriter(const PipeViewWriter&) = delete;
+  PipeViewWriter& operator=(const PipeViewWriter&) = delete;
+
+  /* The instruction was fetched in the given cycle, and will be decoded
+   * from the next cycle on.
+   */
+  void recordFetch(uint64_t seq, MemAddress PC, uint32_t instructionWord,
+                   uint64_t cycle);
+
+  /* The instruction entered stage in the given cycle. Only the first
+   * call for every instruction and stage has effect.
+   */
+  void recordStage(uint64_t seq, Stage stage, uint64_t cycle);
+
+  /* The instruction retired in the given cycle; all older instructions
+   * that did not retire have been squashed.
+   */
+  void recordRetire(uint64_t seq, uint64_t cycle, bool isStore);
+
+private:
+  struct Entry {
+    uint64_t seq{};
+    MemAddress PC{};
+    uint32_t instructionWord{};
+    uint64_t fetch{};
+    uint64_t decode{};
+    uint64_t execute{};
+    uint64_t memory{};
+  };
+
+  /* Ticks are written as in gem5 with a 1 GHz clock. Cycle n is
+   * written as tick (n + 1) * 1000, such that a tick of zero keeps its
+   * meaning of "did not happen".
+   */
+  static constexpr uint64_t TicksPerCycle = 1000;
+
+  std::ofstream file;
+  std::deque<Entry> inFlight{};
+
+  Entry* find(uint64_t seq);
+  void write(const Entry& entry, uint64_t retireTick, uint64_t storeTick);
+
+  static uint64_t toTick(uint64_t cycle) { return (cycle + 1) * TicksPerCycle; }
+};
+
+#endif /* __PIPEVIEW_H__ */
@@ -0,0 +1,191 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    pixel-convert.cc - Conversion of 8-bit framebuffer pixels to RGBA.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "pixel-convert.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAVE_X86_KERNELS
+
+#ifdef _MSC_VER
+#include <intrin.h>
+/* MSVC accepts AVX2 intrinsics in any function */
+#define TARGET_AVX2
+#else
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+/*
+ * Scalar kernels, for any host
+ */
+
+static inline uint32_t
+greyToRGBA(uint8_t value)
+{
+  return value * 0x01010100U | 0xff;
+}
+
+static void
+convertY8Scalar(uint32_t* dst, const uint8_t* src, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+    dst[i] = greyToRGBA(src[i]);
+}
+
+static void
+convertIndexedScalar(uint32_t* dst, const uint8_t* src, size_t count,
+                     const uint32_t* palette)
+{
+  for (size_t i = 0; i < count; i++)
+    dst[i] = palette[src[i]];
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * SSE2 kernels, part of the x86-64 base instruction set
+ */
+
+/* Widens 16 grey values at a time by interleaving them with themselves */
+static void
+convertY8SSE2(uint32_t* dst, const uint8_t* src, size_t count)
+{
+  const __m128i alpha = _mm_set1_epi32(0xff);
+
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)&src[i]);
+    __m128i lo = _mm_unpacklo_epi8(v, v);
+    __m128i hi = _mm_unpackhi_epi8(v, v);
+
+    /* Every 32-bit lane now holds the value four times, A is set */
+    _mm_storeu_si128((__m128i*)&dst[i],
+                     _mm_or_si128(_mm_unpacklo_epi16(lo, lo), alpha));
+    _mm_storeu_si128((__m128i*)&dst[i + 4],
+                     _mm_or_si128(_mm_unpackhi_epi16(lo, lo), alpha));
+    _mm_storeu_si128((__m128i*)&dst[i + 8],
+                     _mm_or_si128(_mm_unpacklo_epi16(hi, hi), alpha));
+    _mm_storeu_si128((__m128i*)&dst[i + 12],
+                     _mm_or_si128(_mm_unpackhi_epi16(hi, hi), alpha));
+  }
+
+  convertY8Scalar(&dst[i], &src[i], count - i);
+}
+
+/*
+ * AVX2 kernels, used when the host supports them
+ */
+
+/* Shuffle control that places grey value p in bytes 1-3 of a 32-bit
+ * lane and clears byte 0, which receives the alpha value.
+ */
+static constexpr int
+greyControl(int p)
+{
+  return p << 24 | p << 16 | p << 8 | 0x80;
+}
+
+/* Both 128-bit lanes receive the same 16 grey values, as vpshufb only
+ * selects bytes within a lane. Each shuffle produces eight pixels,
+ * four per lane.
+ */
+TARGET_AVX2 static void
+convertY8AVX2(uint32_t* dst, const uint8_t* src, size_t count)
+{
+  const __m256i alpha = _mm256_set1_epi32(0xff);
+  const __m256i control[2] = {
+      _mm256_setr_epi32(greyControl(0), greyControl(1), greyControl(2),
+                        greyControl(3), greyControl(4), greyControl(5),
+                        greyControl(6), greyControl(7)),
+      _mm256_setr_epi32(greyControl(8), greyControl(9), greyControl(10),
+                        greyControl(11), greyControl(12), greyControl(13),
+                        greyControl(14), greyControl(15)),
+  };
+
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i v = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i*)&src[i]));
+
+    _mm256_storeu_si256(
+        (__m256i*)&dst[i],
+        _mm256_or_si256(_mm256_shuffle_epi8(v, control[0]), alpha));
+    _mm256_storeu_si256(
+        (__m256i*)&dst[i + 8],
+        _mm256_or_si256(_mm256_shuffle_epi8(v, control[1]), alpha));
+  }
+
+  convertY8Scalar(&dst[i], &src[i], count - i);
+}
+
+/* Looks up eight palette entries at a time with a gather */
+TARGET_AVX2 static void
+convertIndexedAVX2(uint32_t* dst, const uint8_t* src, size_t count,
+                   const uint32_t* palette)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i index =
+        _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&src[i]));
+    _mm256_storeu_si256(
+        (__m256i*)&dst[i],
+        _mm256_i32gather_epi32((const int*)palette, index, 4));
+  }
+
+  convertIndexedScalar(&dst[i], &src[i], count - i, palette);
+}
+
+static bool
+hostSupportsAVX2()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  /* The OS must also save the YMM registers (OSXSAVE and XCR0) */
+  __cpuid(info, 1);
+  const int osxsaveAVX = 1 << 27 | 1 << 28;
+  if ((info[2] & osxsaveAVX) != osxsaveAVX || (_xgetbv(0) & 0x6) != 0x6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+const std::vector<PixelConverter>&
+getPixelConverters()
+{
+  static const std::vector<PixelConverter> converters = [] {
+    std::vector<PixelConverter> list{
+        {"scalar", convertY8Scalar, convertIndexedScalar}};
+
+#ifdef HAVE_X86_KERNELS
+    /* SSE2 has no gather, the scalar table lookup is used instead */
+    list.push_back({"sse2", convertY8SSE2, convertIndexedScalar});
+    if (hostSupportsAVX2())
+      list.push_back({"avx2", convertY8AVX2, convertIndexedAVX2});
+#endif
+
+    return list;
+  }();
+
+  return converters;
+}
+
+const PixelConverter&
+getPixelConverter()
+{
+  return getPixelConverters().back();
+}
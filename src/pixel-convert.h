@@ -0,0 +1,39 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    pixel-convert.h - Conversion of 8-bit framebuffer pixels to RGBA.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __PIXEL_CONVERT_H__
+#define __PIXEL_CONVERT_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Kernels that convert count 8-bit pixels of the Y8 (greyscale) and
+ * indexed framebuffer modes to RGBA8888, that is, 32-bit values with R
+ * in the most significant byte and A in the least significant byte.
+ * Neither pointer needs to be aligned.
+ */
+using ConvertY8Func = void (*)(uint32_t* dst, const uint8_t* src,
+                               size_t count);
+using ConvertIndexedFunc = void (*)(uint32_t* dst, const uint8_t* src,
+                                    size_t count, const uint32_t* palette);
+
+struct PixelConverter {
+  const char* name;
+  ConvertY8Func convertY8;
+  ConvertIndexedFunc convertIndexed;
+};
+
+/* The kernels supported by the host CPU, starting with the portable
+ * scalar ones.
+ */
+const std::vector<PixelConverter>& getPixelConverters();
+
+/* The fastest kernels supported by the host CPU, selected on first use */
+const PixelConverter& getPixelConverter();
+
+#endif /* __PIXEL_CONVERT_H__ */
@@ -8,19 +8,66 @@
 #include "processor.h"
 #include "framebuffer.h"
 #include "inst-decoder.h"
-#include "serial.h"
+#include "memory.h"
 
+#include <algorithm>
+#include <ctime>
 #include <iomanip>
 #include <iostream>
 
+#ifdef _MSC_VER
+/* Keeps std::max usable */
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+/* CPU time used by the emulator process, in seconds */
+static double
+getCPUTime()
+{
+#ifdef _MSC_VER
+  /* clock() measures wall-clock time on Windows */
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    return 0.0;
+
+  ULARGE_INTEGER time;
+  time.LowPart = user.dwLowDateTime;
+  time.HighPart = user.dwHighDateTime;
+  uint64_t ticks = time.QuadPart;
+  time.LowPart = kernel.dwLowDateTime;
+  time.HighPart = kernel.dwHighDateTime;
+  ticks += time.QuadPart;
+  return ticks * 100e-9;
+#else
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
 Processor::Processor(ELFFile& program, bool pipelining, bool debugMode)
     : bus{program.createMemories()}, instructionMemory{bus}, dataMemory{bus},
-      pipeline{pipelining, debugMode, PC,        instructionMemory,
-               decoder,    regfile,   dataMemory}
+      syscalls{bus}, debugMode{debugMode}, symbols{program.getSymbolTable()},
+      pipeline{pipelining, debugMode, PC,       instructionMemory,
+               decoder,    regfile,   dataMemory, csrFile,
+               syscalls,   &symbols}
 {
-  bus.addClient(std::make_unique<Serial>(0x200));
+  /* Without RAM the heap cannot grow beyond the program's segments */
+  MemAddress programEnd = 0;
+  for (const auto& region : bus.getRegions())
+    programEnd = std::max(programEnd, region.base + region.size);
+  syscalls.setBreak(programEnd);
+
+  auto serialDevice = std::make_unique<Serial>(0x200, bus);
+  serial = serialDevice.get();
+  bus.addClient(std::move(serialDevice));
 
   auto status = std::make_unique<SysStatus>(0x270);
+  status->setCounterSource(
+      [this](PerfCounter counter) { return readCounter(counter); });
+  csrFile.setCounterSource(
+      [this](PerfCounter counter) { return readCounter(counter); });
+  syscalls.setCounterSource(
+      [this](PerfCounter counter) { return readCounter(counter); });
   sysStatus = status.get();
   bus.addClient(std::move(status));
 
@@ -32,6 +79,127 @@ Processor::Processor(ELFFile& program, bool pipelining, bool debugMode)
   PC = program.getEntrypoint();
 }
 
+void
+Processor::addRAM(MemAddress base, size_t size)
+{
+  auto memory = Memory::createZeroed("ram", base, size);
+  memory->setMayWrite(true);
+  bus.addClient(std::move(memory));
+
+  /* The heap starts at the bottom of the first RAM region */
+  if (ramRegions.empty())
+    syscalls.setBreak(base);
+
+  ramRegions.push_back({base, size});
+  if (cosim)
+    cosim->addRAM(base, size);
+}
+
+void
+Processor::useOutOfOrderCore(const OoOConfig& config)
+{
+  oooCore = std::make_unique<OutOfOrderCore>(config, debugMode, PC,
+                                             instructionMemory, decoder,
+                                             regfile, dataMemory, csrFile,
+                                             syscalls, &symbols);
+  oooCore->setProfiler(profiler.get());
+  oooCore->setTracer(tracer.get());
+  oooCore->setCoSimulator(cosim.get());
+}
+
+void
+Processor::enableProfiler(const ELFFile& program, bool callGraph)
+{
+  profiler = std::make_unique<Profiler>(program, &symbols);
+  if (callGraph)
+    profiler->enableCallGraph();
+
+  pipeline.setProfiler(profiler.get());
+  if (oooCore)
+    oooCore->setProfiler(profiler.get());
+}
+
+void
+Processor::enableTrace(const std::string& filename)
+{
+  tracer = std::make_unique<TraceWriter>(filename);
+
+  pipeline.setTracer(tracer.get());
+  if (oooCore)
+    oooCore->setTracer(tracer.get());
+}
+
+void
+Processor::enableCoSimulation(const ELFFile& program, size_t batchSize)
+{
+  cosim = std::make_unique<CoSimulator>(program, batchSize);
+  for (const auto& region : ramRegions)
+    cosim->addRAM(region.base, region.size);
+
+  pipeline.setCoSimulator(cosim.get());
+  if (oooCore)
+    oooCore->setCoSimulator(cosim.get());
+
+  /* The reference model cannot execute system calls, it is sent the
+   * memory they wrote instead.
+   */
+  syscalls.setWriteObserver([this](uint64_t index, MemAddress addr,
+                                   const std::byte* data, size_t size) {
+    cosim->recordWrite(index, addr, data, size);
+  });
+}
+
+void
+Processor::enablePipeView(const std::string& filename)
+{
+  pipeView = std::make_unique<PipeViewWriter>(filename);
+  pipeline.setPipeView(pipeView.get());
+}
+
+void
+Processor::setSerialOutput(std::ostream& os)
+{
+  serial->setSink(os);
+}
+
+void
+Processor::setSerialInput(std::unique_ptr<SerialInput> input)
+{
+  serial->setInput(std::move(input));
+}
+
+void
+Processor::setSandbox(const std::string& directory)
+{
+  syscalls.setSandbox(directory);
+}
+
+void
+Processor::setProgramArguments(const std::vector<std::string>& argv,
+                               const std::vector<std::string>& envp)
+{
+  if (ramRegions.empty())
+    return;
+
+  const MemoryRegion& stack = ramRegions.back();
+  regfile.writeRegister(2, syscalls.setupStack(stack.base + stack.size, argv,
+                                               envp));
+}
+
+void
+Processor::enableMemoryAnalyzer()
+{
+  memoryAnalyzer = std::make_unique<MemoryAnalyzer>(&symbols);
+  bus.setAnalyzer(memoryAnalyzer.get());
+}
+
+void
+Processor::enableHostStatistics(double progressInterval)
+{
+  hostStatistics = true;
+  this->progressInterval = progressInterval;
+}
+
 /* This method is used to initialize registers using values
  * passed as command-line argument.
  */
@@ -63,43 +231,192 @@ Processor::getRegister(RegNumber regnum) const
 bool
 Processor::run(bool testMode)
 {
-  while (!sysStatus->shouldHalt()) {
+  startTime = lastProgressTime = HostClock::now();
+  const double cpuStart = getCPUTime();
+
+  bool result = execute(testMode);
+
+  wallTime =
+      std::chrono::duration<double>(HostClock::now() - startTime).count();
+  cpuTime = getCPUTime() - cpuStart;
+  return result;
+}
+
+void
+Processor::reportProgress()
+{
+  const auto now = HostClock::now();
+  const double elapsed =
+      std::chrono::duration<double>(now - lastProgressTime).count();
+  if (elapsed < progressInterval)
+    return;
+
+  const uint64_t instructions = readCounter(PerfCounter::InstrCompleted);
+  const double total = std::chrono::duration<double>(now - startTime).count();
+
+  /* Keep the order with the program's output */
+  serial->flush();
+
+  auto storeFlags(std::cerr.flags());
+  auto storePrecision(std::cerr.precision());
+  std::cerr << std::fixed << std::setprecision(1) << "[" << total << " s] "
+            << nCycles << " clock cycles, " << instructions
+            << " instructions completed, " << std::setprecision(2)
+            << (nCycles - lastProgressCycles) / elapsed / 1e6 << " MHz, "
+            << (instructions - lastProgressInstructions) / elapsed / 1e6
+            << " MIPS." << std::endl;
+  std::cerr.flags(storeFlags);
+  std::cerr.precision(storePrecision);
+
+  lastProgressTime = now;
+  lastProgressCycles = nCycles;
+  lastProgressInstructions = instructions;
+}
+
+bool
+Processor::execute(bool testMode)
+{
+  if (cosim) {
+    std::array<RegValue, NumRegs> regs{};
+    for (RegNumber i = 0; i < NumRegs; ++i)
+      regs[i] = regfile.readRegister(i);
+    cosim->start(PC, regs);
+  }
+
+  while (!sysStatus->shouldHalt() && !syscalls.hasExited()) {
     try {
       /* The "bus clock" runs at 1/5 the frequency of the Processor. */
       if (nCycles % 5 == 0)
         bus.clockPulse();
 
-      pipeline.propagate();
-      pipeline.clockPulse();
+      if (oooCore)
+        oooCore->clockPulse();
+      else {
+        pipeline.propagate();
+        pipeline.clockPulse();
+      }
       ++nCycles;
+
+      if (progressInterval > 0.0 && nCycles % ProgressCheckCycles == 0)
+        reportProgress();
     } catch (TestEndMarkerEncountered& e) {
+      serial->flush();
+      if (!finishCoSimulation())
+        return false;
       if (testMode)
         return true;
       /* else */
-      std::cerr << "ABNORMAL PROGRAM TERMINATION; PC = " << std::hex << PC
-                << std::dec << std::endl;
-      std::cerr << "Reason: " << e.what() << std::endl;
+      reportTermination(e);
       return false;
     } catch (InstructionFetchFailure& e) {
+      serial->flush();
       if (testMode)
         return true;
       /* else */
-      std::cerr << "ABNORMAL PROGRAM TERMINATION; PC = " << std::hex << PC
-                << std::dec << std::endl;
-      std::cerr << "Reason: " << e.what() << std::endl;
+      reportTermination(e);
+      return false;
+    } catch (CoSimDivergence& e) {
+      serial->flush();
+      reportDivergence(e);
       return false;
     } catch (std::exception& e) {
       /* Catch exceptions such as IllegalInstruction and InvalidAccess */
-      std::cerr << "ABNORMAL PROGRAM TERMINATION; PC = " << std::hex << PC
-                << std::dec << std::endl;
-      std::cerr << "Reason: " << e.what() << std::endl;
+      serial->flush();
+      reportTermination(e);
       return false;
     }
   }
 
+  /* Reported after the program's remaining output */
+  serial->flush();
+  if (syscalls.hasExited())
+    std::cerr << "Program exited with status " << syscalls.getExitStatus()
+              << "." << std::endl;
+  else
+    std::cerr << "System halt requested." << std::endl;
+
+  try {
+    if (oooCore)
+      oooCore->recordHalt();
+    else
+      pipeline.recordHalt();
+  } catch (CoSimDivergence& e) {
+    reportDivergence(e);
+    return false;
+  }
+  if (tracer)
+    tracer->recordHalt();
+
+  return finishCoSimulation();
+}
+
+/* Current value of a performance counter, as read by the program */
+uint64_t
+Processor::readCounter(PerfCounter counter) const
+{
+  switch (counter) {
+  case PerfCounter::Cycles:
+    return nCycles;
+  case PerfCounter::InstrIssued:
+    return oooCore ? oooCore->getInstrIssued() : pipeline.getInstrIssued();
+  case PerfCounter::InstrCompleted:
+    return oooCore ? oooCore->getInstrCompleted()
+                   : pipeline.getInstrCompleted();
+  case PerfCounter::Stalls:
+    return oooCore ? oooCore->getRenameStalls() : pipeline.getStalls();
+  case PerfCounter::BytesRead:
+    return bus.getBytesRead();
+  case PerfCounter::BytesWritten:
+    return bus.getBytesWritten();
+  case PerfCounter::ControlFlushes:
+    return oooCore ? oooCore->getMispredictions() : pipeline.getFlushes();
+  }
+
+  return 0;
+}
+
+/* The PC is followed by the function it lies in, as in the -d trace. */
+void
+Processor::reportTermination(const std::exception& e) const
+{
+  std::cerr << "ABNORMAL PROGRAM TERMINATION; PC = " << std::hex << PC
+            << std::dec;
+  if (symbols.lookup(PC))
+    std::cerr << " <" << symbols.format(PC) << ">";
+  std::cerr << std::endl;
+  std::cerr << "Reason: " << e.what() << std::endl;
+}
+
+/* Check the instructions retired since the last co-simulation check. */
+bool
+Processor::finishCoSimulation()
+{
+  if (!cosim)
+    return true;
+
+  try {
+    cosim->finish();
+  } catch (CoSimDivergence& e) {
+    reportDivergence(e);
+    return false;
+  }
+
   return true;
 }
 
+void
+Processor::reportDivergence(const CoSimDivergence& e)
+{
+  diverged = true;
+
+  reportTermination(e);
+
+  if (!oooCore) {
+    std::cerr << "Pipeline registers:" << std::endl;
+    pipeline.dumpRegisters(std::cerr);
+  }
+}
+
 void
 Processor::dumpRegisters() const
 {
@@ -122,11 +439,72 @@ Processor::dumpRegisters() const
 void
 Processor::dumpStatistics() const
 {
+  if (oooCore) {
+    std::cerr << nCycles << " clock cycles, " << oooCore->getInstrIssued()
+              << " instructions issued, " << oooCore->getInstrCompleted()
+              << " instructions completed." << std::endl;
+    std::cerr << oooCore->getInstrSquashed() << " instructions squashed, "
+              << oooCore->getMispredictions() << " mispredictions, "
+              << oooCore->getLoadsForwarded() << " loads forwarded, "
+              << oooCore->getRenameStalls() << " rename stall cycles."
+              << std::endl;
+    std::cerr << bus.getBytesRead() << " bytes read, "
+              << bus.getBytesWritten() << " bytes written." << std::endl;
+    if (memoryAnalyzer)
+      memoryAnalyzer->dumpStrides(std::cerr);
+    dumpHostStatistics();
+    return;
+  }
+
   std::cerr << nCycles << " clock cycles, " << pipeline.getInstrIssued()
             << " instructions issued, " << pipeline.getInstrCompleted()
             << " instructions completed." << std::endl;
-  if (pipeline.getPipelining())
+  if (pipeline.getPipelining()) {
     std::cerr << pipeline.getStalls() << " stall cycles inserted." << std::endl;
+    dumpCycleStack(std::cerr, pipeline.getCycleStack(), nCycles,
+                   pipeline.getInstrCompleted());
+  }
   std::cerr << bus.getBytesRead() << " bytes read, " << bus.getBytesWritten()
             << " bytes written." << std::endl;
+  if (memoryAnalyzer)
+    memoryAnalyzer->dumpStrides(std::cerr);
+  dumpHostStatistics();
+}
+
+void
+Processor::dumpHostStatistics() const
+{
+  if (!hostStatistics || wallTime <= 0.0)
+    return;
+
+  auto storeFlags(std::cerr.flags());
+  auto storePrecision(std::cerr.precision());
+  std::cerr << std::fixed << std::setprecision(2) << wallTime
+            << " s wall-clock time, " << cpuTime << " s CPU time, "
+            << nCycles / wallTime / 1e6 << " MHz simulated, "
+            << readCounter(PerfCounter::InstrCompleted) / wallTime / 1e6
+            << " MIPS." << std::endl;
+  std::cerr.flags(storeFlags);
+  std::cerr.precision(storePrecision);
+}
+
+void
+Processor::writeProfile(std::ostream& os) const
+{
+  if (profiler)
+    profiler->writeListing(os);
+}
+
+void
+Processor::writeFoldedStacks(std::ostream& os) const
+{
+  if (profiler)
+    profiler->writeFoldedStacks(os);
+}
+
+void
+Processor::writeMemoryHeatmap(std::ostream& os)
+{
+  if (memoryAnalyzer)
+    memoryAnalyzer->writeHeatmap(os, bus);
 }
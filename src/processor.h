@@ -10,9 +10,19 @@
 
 #include "arch.h"
 
+#include "cosim.h"
+#include "csr-file.h"
 #include "elf-file.h"
+#include "ooo-core.h"
 #include "pipeline.h"
+#include "pipeview.h"
+#include "profiler.h"
+#include "serial.h"
 #include "sys-status.h"
+#include "syscalls.h"
+#include "trace.h"
+
+#include <chrono>
 
 class Processor {
 public:
@@ -21,6 +31,58 @@ public:
   Processor(const Processor&) = delete;
   Processor& operator=(const Processor&) = delete;
 
+  /* Add RAM of size bytes at base, which reads as zero initially. Host
+   * memory is only allocated for the pages that the program touches.
+   */
+  void addRAM(MemAddress base, size_t size);
+
+  /* Replace the in-order pipeline by the out-of-order core model */
+  void useOutOfOrderCore(const OoOConfig& config);
+
+  /* Collect a per-instruction profile of the text segment of program,
+   * optionally including a call graph.
+   */
+  void enableProfiler(const ELFFile& program, bool callGraph = false);
+
+  /* Write a binary trace of all retired instructions to filename */
+  void enableTrace(const std::string& filename);
+
+  /* Check every retired instruction against a reference model, in
+   * batches of batchSize instructions.
+   */
+  void enableCoSimulation(const ELFFile& program, size_t batchSize);
+
+  /* Write a pipeline occupancy trace of the in-order pipeline */
+  void enablePipeView(const std::string& filename);
+
+  /* Write the output of the serial device to os instead of std::cerr */
+  void setSerialOutput(std::ostream& os);
+  void setSerialInput(std::unique_ptr<SerialInput> input);
+
+  /* Only allow the program to open files within directory */
+  void setSandbox(const std::string& directory);
+
+  /* Place the arguments and environment of the program on the stack,
+   * at the top of the last RAM region. The stack pointer is set to the
+   * start of the argument vector.
+   */
+  void setProgramArguments(const std::vector<std::string>& argv,
+                           const std::vector<std::string>& envp);
+
+  /* Count the memory accesses per line and page, and the strides of
+   * the memory instructions.
+   */
+  void enableMemoryAnalyzer();
+
+  /* Report the wall-clock and CPU time of run() with the statistics,
+   * along with the simulated clock rate and instructions per second.
+   * With an interval greater than zero, the rates over the last interval
+   * are also printed while the program runs, every interval seconds.
+   */
+  void enableHostStatistics(double progressInterval = 0.0);
+
+  bool hasDiverged() const { return diverged; }
+
   /* Command-line register initialization */
   void initRegister(RegNumber regnum, RegValue value);
   RegValue getRegister(RegNumber regnum) const;
@@ -31,25 +93,67 @@ public:
   /* Debugging and statistics */
   void dumpRegisters() const;
   void dumpStatistics() const;
+  void writeProfile(std::ostream& os) const;
+  void writeFoldedStacks(std::ostream& os) const;
+  void writeMemoryHeatmap(std::ostream& os);
 
 private:
+  uint64_t readCounter(PerfCounter counter) const;
+
+  bool execute(bool testMode);
+  void reportTermination(const std::exception& e) const;
+  void reportProgress();
+  void dumpHostStatistics() const;
+
+  bool finishCoSimulation();
+  void reportDivergence(const CoSimDivergence& e);
+
   /* Statistics */
   uint64_t nCycles{};
+  bool diverged{};
+
+  /* Host performance. The clock is only read for the progress line
+   * every ProgressCheckCycles cycles.
+   */
+  using HostClock = std::chrono::steady_clock;
+  static constexpr uint64_t ProgressCheckCycles = 1 << 16;
+
+  bool hostStatistics{};
+  double progressInterval{};
+  double wallTime{};
+  double cpuTime{};
+  HostClock::time_point startTime{};
+  HostClock::time_point lastProgressTime{};
+  uint64_t lastProgressCycles{};
+  uint64_t lastProgressInstructions{};
 
   /* Components shared by multiple stages or components. */
   RegisterFile regfile{};
   InstructionDecoder decoder{};
+  CSRFile csrFile{};
 
   MemoryBus bus;
   InstructionMemory instructionMemory;
   DataMemory dataMemory;
+  SyscallEmulator syscalls;
 
   MemAddress PC{};
+  std::vector<MemoryRegion> ramRegions{};
+
+  bool debugMode;
+  SymbolTable symbols;
 
   Pipeline pipeline;
+  std::unique_ptr<OutOfOrderCore> oooCore{};
+  std::unique_ptr<Profiler> profiler{};
+  std::unique_ptr<TraceWriter> tracer{};
+  std::unique_ptr<PipeViewWriter> pipeView{};
+  std::unique_ptr<CoSimulator> cosim{};
+  std::unique_ptr<MemoryAnalyzer> memoryAnalyzer{};
 
   /* Memory bus clients */
   SysStatus* sysStatus{}; /* no ownership */
+  Serial* serial{};       /* no ownership */
 };
 
 #endif /* __PROCESSOR_H__ */
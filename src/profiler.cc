@@ -0,0 +1,259 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    profiler.cc - Per-instruction execution profile.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "profiler.h"
+
+#include "elf-file.h"
+#include "inst-decoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+Profiler::Profiler(const ELFFile& program, const SymbolTable* symbols)
+    : symbols{symbols}
+{
+  if (!program.getTextSegment(text, textBase, textSize))
+    throw std::runtime_error("Cannot profile a program without text segment.");
+
+  counters.resize((textSize + 3) / 4);
+}
+
+void
+Profiler::writeListing(std::ostream& os) const
+{
+  std::vector<size_t> executed;
+  uint64_t totalCycles = pendingCycles;
+  uint64_t totalExecutions = 0;
+
+  for (size_t i = 0; i < counters.size(); ++i) {
+    totalCycles += counters[i].cycles;
+    totalExecutions += counters[i].executions;
+    if (counters[i].executions > 0 || counters[i].cycles > 0)
+      executed.push_back(i);
+  }
+
+  std::stable_sort(executed.begin(), executed.end(),
+                   [this](size_t a, size_t b) {
+                     return counters[a].cycles > counters[b].cycles;
+                   });
+
+  auto storeFlags(os.flags());
+
+  os << "Profile: " << totalExecutions << " instructions retired in "
+     << totalCycles << " cycles";
+  if (pendingCycles > 0)
+    os << " (" << pendingCycles << " cycles after the last retirement)";
+  os << std::endl << std::endl;
+
+  if (symbols && !symbols->empty())
+    writeFunctionSummary(os, totalCycles);
+
+  os << std::setfill(' ') << std::right << std::setw(8) << "cycles%"
+     << std::setw(12) << "cycles" << std::setw(12) << "executions"
+     << std::setw(10) << "stalls" << std::setw(10) << "taken"
+     << "  address     instruction" << std::endl;
+
+  InstructionDecoder decoder;
+  for (size_t i : executed) {
+    const Counters& c = counters[i];
+
+    uint32_t instructionWord{};
+    if (i * 4 + sizeof(instructionWord) <= text.size())
+      std::memcpy(&instructionWord, &text[i * 4], sizeof(instructionWord));
+    decoder.setInstructionWord(instructionWord);
+
+    double percentage =
+        totalCycles > 0 ? 100.0 * c.cycles / totalCycles : 0.0;
+
+    os << std::fixed << std::setprecision(2) << std::setw(7) << percentage
+       << "%" << std::setw(12) << c.cycles << std::setw(12) << c.executions
+       << std::setw(10) << c.stalls << std::setw(10) << c.takenBranches
+       << "  ";
+    os.flags(storeFlags);
+
+    std::stringstream address;
+    address << std::hex << std::showbase << textBase + i * 4 << ":";
+    os << std::left << std::setw(12) << address.str();
+    os.flags(storeFlags);
+
+    os << decoder;
+    if (symbols) {
+      std::string name = symbols->format(textBase + i * 4);
+      if (!name.empty())
+        os << "\t<" << name << ">";
+    }
+    os << std::endl;
+  }
+}
+
+void
+Profiler::writeFunctionSummary(std::ostream& os, uint64_t totalCycles) const
+{
+  /* Aggregate the counters per symbol; instructions not covered by
+   * a symbol are collected under an empty name.
+   */
+  std::map<std::string, Counters> functions;
+  for (size_t i = 0; i < counters.size(); ++i) {
+    const Counters& c = counters[i];
+    if (c.executions == 0 && c.cycles == 0)
+      continue;
+
+    const Symbol* symbol = symbols->lookup(textBase + i * 4);
+    Counters& f = functions[symbol ? symbol->name : std::string{}];
+    f.executions += c.executions;
+    f.cycles += c.cycles;
+    f.stalls += c.stalls;
+    f.takenBranches += c.takenBranches;
+  }
+
+  std::vector<std::pair<std::string, Counters>> sorted(functions.begin(),
+                                                       functions.end());
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const auto& a, const auto& b) {
+                     return a.second.cycles > b.second.cycles;
+                   });
+
+  auto storeFlags(os.flags());
+
+  os << std::setfill(' ') << std::right << std::setw(8) << "cycles%"
+     << std::setw(12) << "cycles" << std::setw(12) << "executions"
+     << std::setw(10) << "stalls" << std::setw(10) << "taken"
+     << "  function" << std::endl;
+
+  for (const auto& [name, c] : sorted) {
+    double percentage =
+        totalCycles > 0 ? 100.0 * c.cycles / totalCycles : 0.0;
+
+    os << std::fixed << std::setprecision(2) << std::setw(7) << percentage
+       << "%" << std::setw(12) << c.cycles << std::setw(12) << c.executions
+       << std::setw(10) << c.stalls << std::setw(10) << c.takenBranches
+       << "  " << (name.empty() ? "[unknown]" : name) << std::endl;
+    os.flags(storeFlags);
+  }
+
+  os << std::endl;
+}
+
+void
+Profiler::enableCallGraph()
+{
+  callGraph = true;
+
+  /* Classify the instructions once, such that the shadow call stack
+   * only needs a table lookup per retired instruction.
+   */
+  controlKinds.assign(counters.size(), ControlKind::None);
+
+  InstructionDecoder decoder;
+  for (size_t i = 0; i < controlKinds.size(); ++i) {
+    uint32_t instructionWord{};
+    if (i * 4 + sizeof(instructionWord) > text.size())
+      break;
+    std::memcpy(&instructionWord, &text[i * 4], sizeof(instructionWord));
+    decoder.setInstructionWord(instructionWord);
+
+    try {
+      const Opcode opcode = decoder.getOpcode();
+      if (opcode != Opcode::JAL && opcode != Opcode::JALR)
+        continue;
+
+      if (decoder.getRD() == 1)
+        controlKinds[i] = ControlKind::Call;
+      else if (opcode == Opcode::JALR && decoder.getRD() == 0 &&
+               decoder.getRS1() == 1 && decoder.getImmediateI() == 0)
+        controlKinds[i] = ControlKind::Return;
+    } catch (IllegalInstruction&) {
+      /* Not an instruction, e.g. data in the text segment. */
+    }
+  }
+}
+
+void
+Profiler::updateCallGraph(MemAddress PC)
+{
+  if (frames.empty()) {
+    const Symbol* symbol = symbols ? symbols->lookup(PC) : nullptr;
+    frames.push_back(Frame{symbol ? symbol->address : PC});
+  }
+
+  /* The first instruction retired after a call determines the callee. */
+  if (pendingCall) {
+    pendingCall = false;
+
+    auto it = frames[currentFrame].children.find(PC);
+    if (it != frames[currentFrame].children.end())
+      currentFrame = it->second;
+    else {
+      const size_t child = frames.size();
+      frames[currentFrame].children.emplace(PC, child);
+      frames.push_back(Frame{PC, currentFrame});
+      currentFrame = child;
+    }
+  }
+
+  /* Charge the instruction to the stack it executes in, before the
+   * call or return takes effect.
+   */
+  frames[currentFrame].cycles += pendingCycles;
+
+  switch (controlKinds[(PC - textBase) / 4]) {
+  case ControlKind::Call:
+    pendingCall = true;
+    break;
+  case ControlKind::Return:
+    /* Returns from the root frame (e.g. a return from main when
+     * started without call) leave the stack unchanged.
+     */
+    if (currentFrame != 0)
+      currentFrame = frames[currentFrame].parent;
+    break;
+  case ControlKind::None:
+    break;
+  }
+}
+
+std::string
+Profiler::getFrameName(const Frame& frame) const
+{
+  if (symbols) {
+    std::string name = symbols->format(frame.function);
+    if (!name.empty())
+      return name;
+  }
+
+  std::stringstream ss;
+  ss << std::hex << std::showbase << frame.function;
+  return ss.str();
+}
+
+void
+Profiler::writeFoldedStacks(std::ostream& os) const
+{
+  for (size_t i = 0; i < frames.size(); ++i) {
+    uint64_t cycles = frames[i].cycles;
+    /* Cycles after the last retirement belong to the final stack. */
+    if (i == currentFrame)
+      cycles += pendingCycles;
+    if (cycles == 0)
+      continue;
+
+    std::vector<size_t> path;
+    for (size_t f = i; f != 0; f = frames[f].parent)
+      path.push_back(f);
+    path.push_back(0);
+
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+      if (it != path.rbegin())
+        os << ";";
+      os << getFrameName(frames[*it]);
+    }
+    os << " " << cycles << std::endl;
+  }
+}
@@ -0,0 +1,134 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    profiler.h - Per-instruction execution profile.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "arch.h"
+#include "symbol-table.h"
+
+#include <cstddef>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+class ELFFile;
+
+/* The profiler keeps counters for every instruction in the text segment
+ * in a flat array indexed by the offset into the text segment. The
+ * cores report events through the record methods below; these only
+ * perform a bounds check and a counter increment, such that profiling
+ * can be left enabled on long runs.
+ *
+ * Cycles are attributed to instructions at retirement: every cycle in
+ * which no instruction retires (a bubble) is charged to the next
+ * instruction that does retire. Hence, the cycle counts over all
+ * instructions add up to the total cycle count.
+ *
+ * Optionally, a shadow call stack is maintained from the retired
+ * instructions following the RISC-V calling convention: JAL and JALR
+ * writing ra (x1) are calls, "jalr x0, 0(ra)" is a return. Cycles are
+ * then also charged to the full call stack, which can be written in the
+ * folded-stack format used by flame graph tools.
+ */
+class Profiler {
+public:
+  Profiler(const ELFFile& program, const SymbolTable* symbols = nullptr);
+
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+
+  /* Track the call stack; must be called before the first cycle. */
+  void enableCallGraph();
+
+  void recordCycle() { ++pendingCycles; }
+
+  void recordRetire(MemAddress PC)
+  {
+    if (Counters* c = lookup(PC)) {
+      ++c->executions;
+      c->cycles += pendingCycles;
+      if (callGraph)
+        updateCallGraph(PC);
+      pendingCycles = 0;
+    }
+  }
+
+  void recordStall(MemAddress PC)
+  {
+    if (Counters* c = lookup(PC))
+      ++c->stalls;
+  }
+
+  void recordTakenBranch(MemAddress PC)
+  {
+    if (Counters* c = lookup(PC))
+      ++c->takenBranches;
+  }
+
+  /* Write an annotated disassembly of all executed instructions, the
+   * hottest instruction (most cycles) first. When symbols are available,
+   * this is preceded by a summary per function.
+   */
+  void writeListing(std::ostream& os) const;
+
+  /* Write one line per call stack, "outer;inner cycles", for the stacks
+   * that have been charged cycles.
+   */
+  void writeFoldedStacks(std::ostream& os) const;
+
+private:
+  struct Counters {
+    uint64_t executions{};
+    uint64_t cycles{};
+    uint64_t stalls{};
+    uint64_t takenBranches{};
+  };
+
+  const SymbolTable* symbols; /* no ownership, may be nullptr */
+
+  std::vector<std::byte> text{};
+  MemAddress textBase{};
+  size_t textSize{};
+
+  std::vector<Counters> counters{};
+  uint64_t pendingCycles{};
+
+  /* Call graph: a tree of frames, each identified by the address of
+   * the function that was called. The root frame is the function
+   * containing the first retired instruction.
+   */
+  enum class ControlKind : uint8_t { None, Call, Return };
+
+  struct Frame {
+    MemAddress function{};
+    size_t parent{};
+    uint64_t cycles{};
+    std::unordered_map<MemAddress, size_t> children{};
+  };
+
+  bool callGraph{};
+  std::vector<ControlKind> controlKinds{};
+  std::vector<Frame> frames{};
+  size_t currentFrame{};
+  bool pendingCall{};
+
+  void updateCallGraph(MemAddress PC);
+  std::string getFrameName(const Frame& frame) const;
+
+  void writeFunctionSummary(std::ostream& os, uint64_t totalCycles) const;
+
+  Counters* lookup(MemAddress PC)
+  {
+    const MemAddress offset = PC - textBase;
+    if (offset >= textSize)
+      return nullptr;
+    return &counters[offset / 4];
+  }
+};
+
+#endif /* __PROFILER_H__ */
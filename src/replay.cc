@@ -0,0 +1,276 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    replay.cc - Trace-driven replay of the pipeline timing model.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "replay.h"
+
+#include "elf-file.h"
+#include "pipeline.h"
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+TraceReplay::TraceReplay(TraceReader& reader, const ELFFile& program,
+                         bool pipelining)
+    : reader{reader}, pipelining{pipelining}
+{
+  if (!program.getTextSegment(text, textBase, textSize))
+    throw std::runtime_error("Cannot replay a program without text segment.");
+
+  advance();
+  if (!havePending)
+    throw std::runtime_error("trace is empty");
+
+  fetchPC = pending.PC;
+}
+
+void
+TraceReplay::run()
+{
+  if (pipelining)
+    runPipelined();
+  else
+    runNonPipelined();
+}
+
+/* Mirrors one cycle of Pipeline::propagate and Pipeline::clockPulse per
+ * iteration, see the stages for the corresponding logic.
+ */
+void
+TraceReplay::runPipelined()
+{
+  Slot if_id, id_ex, ex_m, m_wb;
+
+  bool endMarkerSeen = false;
+  int endMarkerCountdown = 0;
+
+  while (true) {
+    /* IF: the instruction memory is read every cycle until the test end
+     * marker is fetched, after which the pipeline drains.
+     */
+    bool markerFetched = false;
+    if (!endMarkerSeen) {
+      bytesRead += 4;
+      if ((!havePending || wrongPath) && readText(fetchPC) == TestEndMarker) {
+        endMarkerSeen = markerFetched = true;
+        endMarkerCountdown = 5;
+      }
+    }
+
+    /* ID: load-use hazard detection */
+    const bool hazard =
+        id_ex.isLoad && id_ex.rd != 0 &&
+        (id_ex.rd == if_id.rs1 || (if_id.usesRS2 && id_ex.rd == if_id.rs2));
+
+    /* EX: jumps and taken branches flush IF and ID */
+    const bool flush = id_ex.redirects;
+
+    /* MEM */
+    bytesRead += ex_m.bytesRead;
+    bytesWritten += ex_m.bytesWritten;
+    const bool halt = ex_m.halt;
+
+    /* WB */
+    CycleCategory category = m_wb.bubble;
+    if (m_wb.PC != 0) {
+      ++nInstrCompleted;
+      if (m_wb.fromTrace)
+        ++nTraceRetired;
+      category = CycleCategory::Base;
+    }
+
+    /* Clock pulse */
+    Slot nextIF = if_id;
+    if (flush || markerFetched) {
+      nextIF = Slot{};
+      nextIF.bubble =
+          flush ? CycleCategory::ControlFlush : CycleCategory::Drain;
+    } else if (!hazard && !endMarkerSeen) {
+      nextIF = fetch();
+      fetchPC += 4;
+    }
+
+    /* The end marker terminates the program once the pipeline drained,
+     * this final cycle is not counted.
+     */
+    if (endMarkerSeen && endMarkerCountdown-- == 0)
+      break;
+
+    ++cycleStack[static_cast<size_t>(category)];
+
+    Slot nextID{};
+    if (flush)
+      nextID.bubble = CycleCategory::ControlFlush;
+    else if (hazard) {
+      ++nStalls;
+      nextID.bubble = CycleCategory::LoadUse;
+    } else {
+      if (if_id.PC != 0)
+        ++nInstrIssued;
+      nextID = if_id;
+    }
+
+    if (flush && havePending) {
+      /* The record after a redirecting one holds the target. */
+      fetchPC = pending.PC;
+      wrongPath = false;
+    }
+
+    m_wb = ex_m;
+    ex_m = id_ex;
+    id_ex = nextID;
+    if_id = nextIF;
+
+    ++nCycles;
+
+    /* The halting store takes effect in MEM. A program that neither
+     * halts nor reaches an end marker ended with an exception, stop
+     * once all traced instructions retired.
+     */
+    if (halt ||
+        (!endMarkerSeen && !havePending && nTraceRetired == nTraceFetched))
+      break;
+  }
+}
+
+/* Without pipelining, each instruction takes five cycles, one per
+ * stage, of which only the write back counts as base cycle.
+ */
+void
+TraceReplay::runNonPipelined()
+{
+  while (havePending) {
+    fetchPC = pending.PC;
+    wrongPath = false;
+    const Slot slot = fetch();
+    fetchPC += 4;
+
+    bytesRead += 4;
+    ++nInstrIssued;
+    bytesRead += slot.bytesRead;
+    bytesWritten += slot.bytesWritten;
+
+    if (slot.halt) {
+      nCycles += 4;
+      cycleStack[static_cast<size_t>(CycleCategory::Structural)] += 4;
+      break;
+    }
+
+    ++nInstrCompleted;
+    nCycles += 5;
+    cycleStack[static_cast<size_t>(CycleCategory::Structural)] += 4;
+    ++cycleStack[static_cast<size_t>(CycleCategory::Base)];
+
+    /* Fetching the end marker stops the program without counting the
+     * cycle.
+     */
+    if (!havePending && readText(fetchPC) == TestEndMarker)
+      bytesRead += 4;
+  }
+}
+
+TraceReplay::Slot
+TraceReplay::fetch()
+{
+  if (havePending && !wrongPath) {
+    if (fetchPC != pending.PC) {
+      std::stringstream ss;
+      ss << "trace diverges from the fetch path at PC " << std::hex
+         << std::showbase << fetchPC;
+      throw std::runtime_error(ss.str());
+    }
+
+    Slot slot = decode(pending.PC, pending.instructionWord);
+    slot.fromTrace = true;
+    slot.halt = pending.halt;
+    if (pending.access == TraceRecord::Access::Load)
+      slot.bytesRead = pending.size;
+    else if (pending.access == TraceRecord::Access::Store)
+      slot.bytesWritten = pending.size;
+
+    const MemAddress sequentialPC = pending.PC + 4;
+    advance();
+    ++nTraceFetched;
+
+    /* A branch was taken when the next retired instruction does not
+     * follow it.
+     */
+    if (slot.isBranch)
+      slot.redirects = havePending && pending.PC != sequentialPC;
+    if (slot.redirects)
+      wrongPath = true;
+
+    return slot;
+  }
+
+  /* Wrong-path instructions, and those following the end of the trace.
+   * Their branches are assumed not taken.
+   */
+  Slot slot = decode(fetchPC, readText(fetchPC));
+  slot.redirects = slot.redirects && !slot.isBranch;
+  return slot;
+}
+
+TraceReplay::Slot
+TraceReplay::decode(MemAddress PC, uint32_t instructionWord) const
+{
+  Slot slot;
+  slot.PC = PC;
+  slot.bubble = CycleCategory::Base;
+
+  InstructionDecoder decoder;
+  decoder.setInstructionWord(instructionWord);
+
+  ControlSignals control;
+  try {
+    control.setFromInstruction(decoder);
+  } catch (IllegalInstruction&) {
+    /* Only possible on a wrong path, which is flushed before decode. */
+    return slot;
+  }
+
+  slot.rd = destinationRegister(decoder);
+  slot.rs1 = decoder.getRS1();
+  slot.rs2 = decoder.getRS2();
+  slot.usesRS2 = instructionUsesRS2(decoder.getOpcode());
+  slot.isLoad = control.getMemToReg();
+  slot.isBranch = control.getBranch();
+  slot.redirects = control.getJump() || control.getBranch();
+
+  return slot;
+}
+
+uint32_t
+TraceReplay::readText(MemAddress PC) const
+{
+  uint32_t instructionWord = NopInstruction;
+  const MemAddress offset = PC - textBase;
+  if (offset < textSize && offset + sizeof(instructionWord) <= text.size())
+    std::memcpy(&instructionWord, &text[offset], sizeof(instructionWord));
+
+  return instructionWord;
+}
+
+void
+TraceReplay::advance()
+{
+  havePending = reader.next(pending);
+}
+
+void
+TraceReplay::dumpStatistics() const
+{
+  std::cerr << nCycles << " clock cycles, " << nInstrIssued
+            << " instructions issued, " << nInstrCompleted
+            << " instructions completed." << std::endl;
+  if (pipelining) {
+    std::cerr << nStalls << " stall cycles inserted." << std::endl;
+    dumpCycleStack(std::cerr, cycleStack, nCycles, nInstrCompleted);
+  }
+  std::cerr << bytesRead << " bytes read, " << bytesWritten
+            << " bytes written." << std::endl;
+}
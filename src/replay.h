@@ -0,0 +1,98 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    replay.h - Trace-driven replay of the pipeline timing model.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include "stages.h"
+#include "trace.h"
+
+#include <array>
+#include <ostream>
+#include <vector>
+
+class ELFFile;
+
+/* Replays a trace written with -T through the timing model of the
+ * in-order pipeline, without executing any instruction: there is no
+ * ALU, register file or memory. The fetch path, hazard detection,
+ * control flow resolution in EX and the bus traffic are modeled cycle
+ * by cycle exactly like the live Pipeline does, so the statistics match
+ * those of a live run with the same configuration.
+ *
+ * The trace only contains retired instructions. Instructions that are
+ * fetched on a wrong path, or after the last traced instruction, are
+ * taken from the text segment of the program. This is also how a test
+ * end marker following the trace is found.
+ */
+class TraceReplay {
+public:
+  TraceReplay(TraceReader& reader, const ELFFile& program, bool pipelining);
+
+  TraceReplay(const TraceReplay&) = delete;
+  TraceReplay& operator=(const TraceReplay&) = delete;
+
+  void run();
+
+  void dumpStatistics() const;
+
+private:
+  /* The timing relevant properties of an instruction in a pipeline
+   * register. A PC of zero marks a bubble.
+   */
+  struct Slot {
+    MemAddress PC{};
+    CycleCategory bubble{CycleCategory::Drain};
+
+    RegNumber rd{};
+    RegNumber rs1{};
+    RegNumber rs2{};
+    bool usesRS2{};
+    bool isLoad{};
+    bool isBranch{};
+    bool redirects{}; /* jump or taken branch, resolved in EX */
+
+    uint8_t bytesRead{};
+    uint8_t bytesWritten{};
+    bool halt{};
+    bool fromTrace{};
+  };
+
+  TraceReader& reader;
+  bool pipelining;
+
+  std::vector<std::byte> text{};
+  MemAddress textBase{};
+  size_t textSize{};
+
+  /* The next trace record that has not been fetched yet. */
+  TraceRecord pending{};
+  bool havePending{};
+  bool wrongPath{};
+  MemAddress fetchPC{};
+  uint64_t nTraceFetched{};
+  uint64_t nTraceRetired{};
+
+  /* Statistics, as kept by the Processor, Pipeline and MemoryBus */
+  uint64_t nCycles{};
+  uint64_t nInstrIssued{};
+  uint64_t nInstrCompleted{};
+  uint64_t nStalls{};
+  uint64_t bytesRead{};
+  uint64_t bytesWritten{};
+  std::array<uint64_t, NumCycleCategories> cycleStack{};
+
+  void runPipelined();
+  void runNonPipelined();
+
+  Slot fetch();
+  Slot decode(MemAddress PC, uint32_t instructionWord) const;
+  uint32_t readText(MemAddress PC) const;
+  void advance();
+};
+
+#endif /* __REPLAY_H__ */
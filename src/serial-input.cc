@@ -0,0 +1,154 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    serial-input.cc - Host input sources for the serial interface.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "serial-input.h"
+
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+
+#ifdef _MSC_VER
+#include <io.h>
+
+#define open _open
+#define read _read
+#define close _close
+#else
+#include <unistd.h>
+#endif
+
+/*
+ * StreamInput
+ */
+
+StreamInput::StreamInput(const std::string& filename)
+    : state{std::make_shared<State>()}
+{
+  if (filename == "-")
+    state->fd = 0;
+  else {
+    state->fd = open(filename.c_str(), O_RDONLY);
+    if (state->fd < 0)
+      throw std::runtime_error("cannot open serial input file " + filename);
+    state->ownsFd = true;
+  }
+
+  std::thread(readLoop, state).detach();
+}
+
+void
+StreamInput::readLoop(std::shared_ptr<State> state)
+{
+  char buffer[4096];
+  while (true) {
+    const auto count = read(state->fd, buffer, sizeof(buffer));
+    if (count <= 0)
+      break;
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->pending.insert(state->pending.end(), buffer, buffer + count);
+  }
+
+  if (state->ownsFd)
+    close(state->fd);
+  state->done = true;
+}
+
+bool
+StreamInput::receive(uint64_t poll, std::deque<char>& queue)
+{
+  /* Checked first, all bytes have been queued once done is set */
+  const bool ended = state->done;
+
+  std::lock_guard<std::mutex> lock(state->mutex);
+  queue.insert(queue.end(), state->pending.begin(), state->pending.end());
+  state->pending.clear();
+
+  return ended;
+}
+
+/*
+ * ReplayInput
+ */
+
+ReplayInput::ReplayInput(const std::string& filename)
+{
+  std::ifstream file(filename);
+  if (!file)
+    throw std::runtime_error("cannot open serial input log " + filename);
+
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream ss(line);
+    uint64_t poll;
+    std::string bytes;
+    if (!(ss >> poll >> bytes))
+      throw std::runtime_error("malformed serial input log line: " + line);
+
+    if (bytes == "end") {
+      hasEnd = true;
+      endPoll = poll;
+      continue;
+    }
+
+    if (bytes.size() % 2 != 0)
+      throw std::runtime_error("malformed serial input log line: " + line);
+
+    Arrival arrival{poll, {}};
+    for (size_t i = 0; i < bytes.size(); i += 2)
+      arrival.bytes.push_back(
+          static_cast<char>(std::stoul(bytes.substr(i, 2), nullptr, 16)));
+    arrivals.push_back(std::move(arrival));
+  }
+}
+
+bool
+ReplayInput::receive(uint64_t poll, std::deque<char>& queue)
+{
+  for (; next < arrivals.size() && arrivals[next].poll <= poll; ++next)
+    queue.insert(queue.end(), arrivals[next].bytes.begin(),
+                 arrivals[next].bytes.end());
+
+  return next == arrivals.size() && hasEnd && endPoll <= poll;
+}
+
+/*
+ * RecordingInput
+ */
+
+RecordingInput::RecordingInput(std::unique_ptr<SerialInput> input,
+                               const std::string& filename)
+    : input{std::move(input)}, log{filename}
+{
+  if (!log)
+    throw std::runtime_error("cannot open serial input log " + filename);
+}
+
+bool
+RecordingInput::receive(uint64_t poll, std::deque<char>& queue)
+{
+  const size_t first = queue.size();
+  const bool end = input->receive(poll, queue);
+
+  if (queue.size() > first) {
+    log << poll << " " << std::hex << std::setfill('0');
+    for (size_t i = first; i < queue.size(); ++i)
+      log << std::setw(2)
+          << static_cast<unsigned>(static_cast<uint8_t>(queue[i]));
+    log << std::dec << "\n";
+  }
+
+  if (end && !ended) {
+    log << poll << " end" << std::endl;
+    ended = true;
+  }
+
+  return end;
+}
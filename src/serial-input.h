@@ -0,0 +1,103 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    serial-input.h - Host input sources for the serial interface.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __SERIAL_INPUT_H__
+#define __SERIAL_INPUT_H__
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Supplies the bytes received by the serial interface. Time is measured
+ * in polls: the number of reads of the receive registers by the guest,
+ * which does not depend on the speed of the host.
+ */
+class SerialInput {
+public:
+  virtual ~SerialInput() = default;
+
+  /* Append the bytes that arrived by the given poll to queue, without
+   * blocking. Returns true once no more bytes will arrive.
+   */
+  virtual bool receive(uint64_t poll, std::deque<char>& queue) = 0;
+};
+
+/* Input read from a file, or standard input for "-", by a background
+ * thread. Bytes arrive whenever the host delivers them, so runs are
+ * not reproducible unless the input is recorded.
+ */
+class StreamInput : public SerialInput {
+public:
+  StreamInput(const std::string& filename);
+  ~StreamInput() override = default;
+
+  StreamInput(const StreamInput&) = delete;
+  StreamInput& operator=(const StreamInput&) = delete;
+
+  bool receive(uint64_t poll, std::deque<char>& queue) override;
+
+private:
+  /* Shared with the reader thread, which is detached as it may be
+   * blocked reading from a terminal when the simulation ends.
+   */
+  struct State {
+    std::mutex mutex{};
+    std::vector<char> pending{};
+    std::atomic<bool> done{};
+    int fd{-1};
+    bool ownsFd{};
+  };
+
+  std::shared_ptr<State> state;
+
+  static void readLoop(std::shared_ptr<State> state);
+};
+
+/* Replays input recorded by a RecordingInput: every byte arrives at the
+ * same poll as in the recorded run, so the run is reproducible.
+ */
+class ReplayInput : public SerialInput {
+public:
+  ReplayInput(const std::string& filename);
+
+  bool receive(uint64_t poll, std::deque<char>& queue) override;
+
+private:
+  struct Arrival {
+    uint64_t poll{};
+    std::string bytes{};
+  };
+
+  std::vector<Arrival> arrivals{};
+  size_t next{};
+  bool hasEnd{};
+  uint64_t endPoll{};
+};
+
+/* Passes on the input of another source and logs when the bytes arrive,
+ * one line per arrival with the poll number and the bytes in hex. The
+ * poll at which the input ended is logged as "<poll> end".
+ */
+class RecordingInput : public SerialInput {
+public:
+  RecordingInput(std::unique_ptr<SerialInput> input,
+                 const std::string& filename);
+
+  bool receive(uint64_t poll, std::deque<char>& queue) override;
+
+private:
+  std::unique_ptr<SerialInput> input;
+  std::ofstream log;
+  bool ended{};
+};
+
+#endif /* __SERIAL_INPUT_H__ */
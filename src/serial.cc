@@ -1,15 +1,49 @@
 /* rv64-emu -- Simple 64-bit RISC-V simulator
  *
- *    serial.cc - Dumb write-only serial interface.
+ *    serial.cc - Simple serial interface.
  *
  * Copyright (C) 2016  Leiden University, The Netherlands.
  */
 
 #include "serial.h"
 
+#include <algorithm>
 #include <iostream>
 
-Serial::Serial(const MemAddress base) : base{base} {}
+Serial::Serial(const MemAddress base, MemoryInterface& memory)
+    : base{base}, memory{memory}, sink{&std::cerr}
+{
+  buffer.reserve(BufferSize);
+}
+
+Serial::~Serial()
+{
+  flush();
+}
+
+void
+Serial::setSink(std::ostream& os)
+{
+  flush();
+  sink = &os;
+}
+
+void
+Serial::setInput(std::unique_ptr<SerialInput> input)
+{
+  this->input = std::move(input);
+}
+
+void
+Serial::flush()
+{
+  if (buffer.empty())
+    return;
+
+  sink->write(buffer.data(), buffer.size());
+  sink->flush();
+  buffer.clear();
+}
 
 /*
  * MemoryInterface
@@ -18,56 +52,154 @@ Serial::Serial(const MemAddress base) : base{base} {}
 uint8_t
 Serial::readByte(MemAddress addr)
 {
-  throw IllegalAccess("Not supported on serial interface");
+  return read(addr);
 }
 
 uint16_t
 Serial::readHalfWord(MemAddress addr)
 {
-  throw IllegalAccess("Not supported on serial interface");
+  return read(addr);
 }
 
 uint32_t
 Serial::readWord(MemAddress addr)
 {
-  throw IllegalAccess("Not supported on serial interface");
+  return read(addr);
 }
 
 uint64_t
 Serial::readDoubleWord(MemAddress addr)
 {
-  throw IllegalAccess("Not supported on serial interface");
+  return read(addr);
 }
 
 void
 Serial::writeByte(MemAddress addr, uint8_t value)
 {
-  if (addr != base)
-    throw IllegalAccess("Invalid address");
-
-  std::cerr << static_cast<char>(value);
+  write(addr, value, sizeof(value));
 }
 
 void
 Serial::writeHalfWord(MemAddress addr, uint16_t value)
 {
-  throw IllegalAccess("Not supported on serial interface");
+  write(addr, value, sizeof(value));
 }
 
 void
 Serial::writeWord(MemAddress addr, uint32_t value)
 {
-  throw IllegalAccess("Not supported on serial interface");
+  write(addr, value, sizeof(value));
 }
 
 void
 Serial::writeDoubleWord(MemAddress addr, uint64_t value)
 {
-  throw IllegalAccess("Not supported on serial interface");
+  write(addr, value, sizeof(value));
 }
 
 bool
 Serial::contains(MemAddress addr) const
 {
-  return base <= addr && addr < base + 1;
+  return base <= addr && addr < base + RegionSize;
+}
+
+std::vector<MemoryRegion>
+Serial::getRegions() const
+{
+  return {{base, RegionSize}};
+}
+
+/*
+ * Private methods
+ */
+
+uint64_t
+Serial::read(MemAddress addr)
+{
+  const MemAddress offset = addr - base;
+  if (offset != StatusOffset && offset != ReceiveOffset)
+    throw IllegalAccess("Not supported on serial interface");
+
+  ++nPolls;
+  if (!input)
+    inputEnded = true;
+  else if (!inputEnded)
+    inputEnded = input->receive(nPolls, received);
+
+  if (offset == StatusOffset) {
+    if (!received.empty())
+      return StatusReceived;
+    return inputEnded ? StatusInputEnded : 0;
+  }
+
+  if (received.empty())
+    return 0;
+
+  const uint8_t byte = received.front();
+  received.pop_front();
+  return byte;
+}
+
+void
+Serial::write(MemAddress addr, uint64_t value, size_t size)
+{
+  switch (addr - base) {
+  case DataOffset: {
+    char data[sizeof(value)];
+    for (size_t i = 0; i < size; ++i)
+      data[i] = static_cast<char>(value >> (8 * i));
+    output(data, size);
+  } break;
+
+  case AddressOffset:
+    if (size != sizeof(bufferAddress))
+      throw IllegalAccess("Invalid access size on serial address register");
+    bufferAddress = value;
+    break;
+
+  case LengthOffset:
+    if (size < 4)
+      throw IllegalAccess("Invalid access size on serial length register");
+    outputBuffer(bufferAddress, value);
+    break;
+
+  default:
+    throw IllegalAccess("Invalid address");
+  }
+}
+
+void
+Serial::output(const char* data, size_t count)
+{
+  while (count > 0) {
+    const size_t n = std::min(count, BufferSize - buffer.size());
+    buffer.insert(buffer.end(), data, data + n);
+
+    const bool newline = std::find(data, data + n, '\n') != data + n;
+    if (newline || buffer.size() == BufferSize)
+      flush();
+
+    data += n;
+    count -= n;
+  }
+}
+
+/* The buffer is copied straight from host memory, like a DMA transfer
+ * it does not pass through the memory bus.
+ */
+void
+Serial::outputBuffer(MemAddress addr, uint64_t length)
+{
+  while (length > 0) {
+    DirectMemoryRange range;
+    if (!memory.getDirectMemoryRange(addr, range) || !range.covers(addr, 1))
+      throw IllegalAccess(addr);
+
+    const size_t offset = addr - range.base;
+    const size_t n = std::min<uint64_t>(length, range.size - offset);
+    output(reinterpret_cast<const char*>(range.data + offset), n);
+
+    addr += n;
+    length -= n;
+  }
 }
@@ -1,6 +1,6 @@
 /* rv64-emu -- Simple 64-bit RISC-V simulator
  *
- *    serial.h - Dumb write-only serial interface.
+ *    serial.h - Simple serial interface.
  *
  * Copyright (C) 2016  Leiden University, The Netherlands.
  */
@@ -9,11 +9,47 @@
 #define __SERIAL_H__
 
 #include "memory-interface.h"
+#include "serial-input.h"
 
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+/* Registers, relative to the base address:
+ *
+ *   0x00  data      A store of 1, 2, 4 or 8 bytes outputs that many
+ *                   characters, the least significant byte first.
+ *   0x08  address   Guest address of a buffer to output (8 bytes).
+ *   0x10  length    Storing a length outputs that many characters from
+ *                   the buffer at address, which must be in RAM.
+ *   0x18  status    Bit 0 is set when a received byte is available, bit
+ *                   1 when the input ended and all bytes have been read.
+ *   0x20  receive   Reading returns the next received byte and removes
+ *                   it, or 0 when none is available.
+ *
+ * Output is buffered and written to the sink at every newline, when the
+ * buffer is full and when flush() is called.
+ *
+ * Without an input source, no bytes are received and the input has
+ * ended. Every read of the status or receive register is a poll, the
+ * input source decides which bytes have arrived by then.
+ */
 class Serial : public MemoryInterface {
 public:
-  Serial(const MemAddress base);
-  ~Serial() override = default;
+  static constexpr size_t BufferSize = 4096;
+
+  Serial(const MemAddress base, MemoryInterface& memory);
+  ~Serial() override;
+
+  Serial(const Serial&) = delete;
+  Serial& operator=(const Serial&) = delete;
+
+  /* Write the buffered output to os from now on, std::cerr by default */
+  void setSink(std::ostream& os);
+  void flush();
+
+  void setInput(std::unique_ptr<SerialInput> input);
 
   /* MemoryInterface */
   uint8_t readByte(MemAddress addr) override;
@@ -27,9 +63,36 @@ public:
   void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
   bool contains(MemAddress addr) const override;
+  std::vector<MemoryRegion> getRegions() const override;
 
 private:
+  static constexpr MemAddress DataOffset = 0x00;
+  static constexpr MemAddress AddressOffset = 0x08;
+  static constexpr MemAddress LengthOffset = 0x10;
+  static constexpr MemAddress StatusOffset = 0x18;
+  static constexpr MemAddress ReceiveOffset = 0x20;
+  static constexpr size_t RegionSize = 0x28;
+
+  static constexpr uint64_t StatusReceived = 0x1;
+  static constexpr uint64_t StatusInputEnded = 0x2;
+
   const MemAddress base;
+  MemoryInterface& memory; /* source of buffer transfers */
+
+  std::ostream* sink;
+  std::vector<char> buffer{};
+
+  MemAddress bufferAddress{};
+
+  std::unique_ptr<SerialInput> input{};
+  std::deque<char> received{};
+  uint64_t nPolls{};
+  bool inputEnded{};
+
+  uint64_t read(MemAddress addr);
+  void write(MemAddress addr, uint64_t value, size_t size);
+  void output(const char* data, size_t count);
+  void outputBuffer(MemAddress addr, uint64_t length);
 };
 
 #endif /* __SERIAL_H__ */
@@ -9,8 +9,6 @@
 
 #include <iostream>
 
-namespace {
-
 bool
 instructionUsesRS2(Opcode opcode)
 {
@@ -25,7 +23,13 @@ instructionUsesRS2(Opcode opcode)
   }
 }
 
-} // namespace
+RegNumber
+destinationRegister(const InstructionDecoder& decoder)
+{
+  if (decoder.getInstructionWord() == EcallInstruction)
+    return SyscallFirstArgument;
+  return decoder.getRD();
+}
 
 /*
  * Control Signals
@@ -46,6 +50,8 @@ ControlSignals::setFromInstruction(const InstructionDecoder& decoder)
   memToReg = false;
   branch = false;
   jump = false;
+  csr = false;
+  syscall = false;
   aluOp = ALUOp::NOP;
   memSize = 0;
   memSignExtend = false;
@@ -91,11 +97,12 @@ ControlSignals::setFromInstruction(const InstructionDecoder& decoder)
       aluOp = ALUOp::OR;
     else if (funct3 == 0x7)
       aluOp = ALUOp::AND;
-    else if (funct3 == 0x1 && funct7 == 0x00)
+    /* The lowest bit of funct7 is bit 5 of the shift amount */
+    else if (funct3 == 0x1 && (funct7 >> 1) == 0x00)
       aluOp = ALUOp::SLL;
-    else if (funct3 == 0x5 && funct7 == 0x00)
+    else if (funct3 == 0x5 && (funct7 >> 1) == 0x00)
       aluOp = ALUOp::SRL;
-    else if (funct3 == 0x5 && funct7 == 0x20)
+    else if (funct3 == 0x5 && (funct7 >> 1) == 0x10)
       aluOp = ALUOp::SRA;
     break;
 
@@ -209,6 +216,20 @@ ControlSignals::setFromInstruction(const InstructionDecoder& decoder)
     aluOp = ALUOp::ADD; /* Add immediate to PC */
     break;
 
+  case Opcode::SYSTEM:
+    /* The CSR is read and written in EX instead of by the ALU */
+    if (funct3 != 0x0 && funct3 != 0x4) {
+      regWrite = true;
+      csr = true;
+    }
+    /* The result of a system call is only known in MEM, like a load */
+    else if (decoder.getInstructionWord() == EcallInstruction) {
+      regWrite = true;
+      memToReg = true;
+      syscall = true;
+    }
+    break;
+
   default:
     /* Leave all as defaults (no-op) */
     break;
@@ -262,6 +283,7 @@ void
 InstructionFetchStage::clockPulse()
 {
   if (!pipelining) {
+    if_id.seq = nextSeq++;
     if_id.PC = PC;
     if_id.instructionWord = fetchedInstruction;
     PC += 4;
@@ -276,11 +298,19 @@ InstructionFetchStage::clockPulse()
   bool stall = control.stallFetch;
 
   if (flush) {
+    if_id.seq = 0;
     if_id.PC = 0;
     if_id.instructionWord = NopInstruction;
+    /* Execute only flushes decode when redirecting the PC, otherwise the
+     * flush is caused by the end marker.
+     */
+    if_id.bubble = control.flushDecode ? CycleCategory::ControlFlush
+                                       : CycleCategory::Drain;
   } else if (!stall && !endMarkerSeen) {
+    if_id.seq = nextSeq++;
     if_id.PC = fetchPC;
     if_id.instructionWord = fetchedInstruction;
+    if_id.bubble = CycleCategory::Base;
     PC += 4;
   }
 
@@ -303,8 +333,10 @@ void dump_instruction(std::ostream& os, const uint32_t instructionWord,
 void
 InstructionDecodeStage::propagate()
 {
+  seq = if_id.seq;
   PC = if_id.PC;
   instructionWord = if_id.instructionWord;
+  bubble = if_id.bubble;
 
   /* Decode the instruction */
   decoder.setInstructionWord(instructionWord);
@@ -323,7 +355,10 @@ InstructionDecodeStage::propagate()
     /* Dump program counter & decoded instruction in debug mode */
     auto storeFlags(std::cerr.flags());
 
-    std::cerr << std::hex << std::showbase << PC << "\t";
+    std::cerr << std::hex << std::showbase << PC;
+    if (symbols && symbols->lookup(PC))
+      std::cerr << " <" << symbols->format(PC) << ">";
+    std::cerr << "\t";
     std::cerr.setf(storeFlags);
 
     std::cerr << decoder << std::endl;
@@ -355,7 +390,7 @@ InstructionDecodeStage::propagate()
 
     bool hazard = false;
 
-    if (id_ex.control.getMemRead() && id_ex.rd != 0) {
+    if (id_ex.control.getMemToReg() && id_ex.rd != 0) {
       if (id_ex.rd == decoder.getRS1())
         hazard = true;
       else if (instructionUsesRS2(decoder.getOpcode()) &&
@@ -379,6 +414,7 @@ InstructionDecodeStage::clockPulse()
       id_ex.control = ControlSignals();
       id_ex.opcode = Opcode::OP;
       id_ex.funct3 = 0;
+      id_ex.bubble = CycleCategory::ControlFlush;
       return;
     }
 
@@ -388,6 +424,7 @@ InstructionDecodeStage::clockPulse()
       id_ex.control = ControlSignals();
       id_ex.opcode = Opcode::OP;
       id_ex.funct3 = 0;
+      id_ex.bubble = CycleCategory::LoadUse;
       return;
     }
   }
@@ -397,16 +434,19 @@ InstructionDecodeStage::clockPulse()
     ++nInstrIssued;
 
   /* Write to pipeline register */
+  id_ex.seq = seq;
   id_ex.PC = PC;
+  id_ex.instructionWord = instructionWord;
   id_ex.readData1 = readData1;
   id_ex.readData2 = readData2;
   id_ex.immediate = decoder.getImmediate();
-  id_ex.rd = decoder.getRD();
+  id_ex.rd = destinationRegister(decoder);
   id_ex.rs1 = decoder.getRS1();
   id_ex.rs2 = decoder.getRS2();
   id_ex.opcode = decoder.getOpcode();
   id_ex.funct3 = decoder.getFunct3();
   id_ex.control = decodedControl;
+  id_ex.bubble = bubble;
 }
 
 /*
@@ -416,7 +456,10 @@ InstructionDecodeStage::clockPulse()
 void
 ExecuteStage::propagate()
 {
+  seq = id_ex.seq;
   PC = id_ex.PC;
+  instructionWord = id_ex.instructionWord;
+  bubble = id_ex.bubble;
 
   pcWriteEnable = false;
   nextPC = 0;
@@ -494,6 +537,24 @@ ExecuteStage::propagate()
     pcWriteEnable = true;
   }
 
+  /* CSRs are read here and written at the end of the cycle. Younger
+   * instructions have not executed yet, so there is no need to stall.
+   */
+  csrWriteEnable = false;
+  if (id_ex.control.getCSR()) {
+    const uint16_t csr = id_ex.immediate & 0xFFF;
+    const RegValue operand = id_ex.funct3 & 0x4 ? id_ex.rs1 : rs1Value;
+
+    aluResult = csrFile.read(csr);
+    if (CSRFile::writesCSR(id_ex.funct3, id_ex.rs1)) {
+      csrWriteEnable = true;
+      csrNumber = csr;
+      csrWriteValue =
+          CSRFile::applyOperation(id_ex.funct3, aluResult, operand);
+    }
+  } else if (id_ex.opcode == Opcode::SYSTEM && !id_ex.control.getSyscall())
+    throw IllegalInstruction("Unsupported system instruction");
+
   /* Pass through write data (for stores) */
   writeData = rs2Value;
   nextRD = id_ex.rd;
@@ -509,16 +570,24 @@ void
 ExecuteStage::clockPulse()
 {
   /* Write to pipeline register */
+  ex_m.seq = seq;
   ex_m.PC = PC;
+  ex_m.instructionWord = instructionWord;
   ex_m.aluResult = aluResult;
   ex_m.writeData = writeData;
   ex_m.rd = nextRD;
   ex_m.control = nextControl;
+  ex_m.bubble = bubble;
 
   if (pcWriteEnable) {
     PCRef = nextPC;
     pcWriteEnable = false;
   }
+
+  if (csrWriteEnable) {
+    csrFile.write(csrNumber, csrWriteValue);
+    csrWriteEnable = false;
+  }
 }
 
 bool
@@ -555,10 +624,14 @@ ExecuteStage::computePCRelativeTarget(MemAddress base, int64_t offset) const
 void
 MemoryStage::propagate()
 {
+  seq = ex_m.seq;
   PC = ex_m.PC;
+  instructionWord = ex_m.instructionWord;
+  bubble = ex_m.bubble;
 
   /* Pass through ALU result */
   aluResult = ex_m.aluResult;
+  writeData = ex_m.writeData;
   memData = 0;
   nextRD = ex_m.rd;
   nextControl = ex_m.control;
@@ -569,6 +642,7 @@ MemoryStage::propagate()
 
   /* Only configure memory if there's a memory operation */
   if (ex_m.control.getMemRead() || ex_m.control.getMemWrite()) {
+    dataMemory.setPC(ex_m.PC);
     dataMemory.setAddress(ex_m.aluResult);
     dataMemory.setSize(ex_m.control.getMemSize());
     dataMemory.setDataIn(ex_m.writeData);
@@ -579,6 +653,21 @@ MemoryStage::propagate()
     if (ex_m.control.getMemRead())
       memData = dataMemory.getDataOut(ex_m.control.getMemSignExtend());
   }
+
+  /* Gather the arguments of a system call. The instruction in WB has not
+   * written back its result yet, forward it.
+   */
+  if (ex_m.control.getSyscall()) {
+    for (size_t i = 0; i < syscallArgs.size(); ++i) {
+      const RegNumber reg = SyscallFirstArgument + i;
+      regfile.setRS1(reg);
+      syscallArgs[i] = regfile.getReadData1();
+
+      if (pipelining && m_wb.control.getRegWrite() && m_wb.rd == reg)
+        syscallArgs[i] =
+            m_wb.control.getMemToReg() ? m_wb.memData : m_wb.aluResult;
+    }
+  }
 }
 
 void
@@ -587,12 +676,19 @@ MemoryStage::clockPulse()
   /* Pulse data memory to perform write if needed */
   dataMemory.clockPulse();
 
+  if (nextControl.getSyscall())
+    memData = syscalls.execute(syscallArgs);
+
   /* Write to pipeline register */
+  m_wb.seq = seq;
   m_wb.PC = PC;
+  m_wb.instructionWord = instructionWord;
   m_wb.aluResult = aluResult;
   m_wb.memData = memData;
+  m_wb.writeData = writeData;
   m_wb.rd = nextRD;
   m_wb.control = nextControl;
+  m_wb.bubble = bubble;
 }
 
 /*
@@ -9,18 +9,22 @@
 #define __STAGES_H__
 
 #include "alu.h"
+#include "csr-file.h"
 #include "inst-decoder.h"
 #include "memory-control.h"
 #include "mux.h"
+#include "symbol-table.h"
+#include "syscalls.h"
 
 static constexpr uint32_t NopInstruction = 0x00000013;
+static constexpr uint32_t EcallInstruction = 0x00000073;
 
 class ControlSignals {
 public:
   ControlSignals()
       : regWrite(false), aluSrc(false), memRead(false), memWrite(false),
-        memToReg(false), branch(false), jump(false), aluOp(ALUOp::NOP),
-        memSize(0), memSignExtend(false)
+        memToReg(false), branch(false), jump(false), csr(false),
+        syscall(false), aluOp(ALUOp::NOP), memSize(0), memSignExtend(false)
   {
   }
 
@@ -33,6 +37,8 @@ public:
   bool getMemToReg() const { return memToReg; }
   bool getBranch() const { return branch; }
   bool getJump() const { return jump; }
+  bool getCSR() const { return csr; }
+  bool getSyscall() const { return syscall; }
   ALUOp getALUOp() const { return aluOp; }
   uint8_t getMemSize() const { return memSize; }
   bool getMemSignExtend() const { return memSignExtend; }
@@ -45,11 +51,44 @@ private:
   bool memToReg;      /* Write to reg from: 0=ALU, 1=mem */
   bool branch;        /* Is branch instruction */
   bool jump;          /* Is jump instruction */
+  bool csr;           /* Is Zicsr instruction */
+  bool syscall;       /* Is ecall, result is written like a load */
   ALUOp aluOp;        /* ALU operation */
   uint8_t memSize;    /* Memory access size (1,2,4,8) */
   bool memSignExtend; /* Sign extend memory read */
 };
 
+/* Categories of the cycle stack. Every clock cycle is attributed to
+ * exactly one category, determined by what reaches the write back stage
+ * in that cycle: either a valid instruction (Base) or a bubble, which
+ * is tagged with the reason it was inserted. Bubbles present while the
+ * pipeline fills at start-up or drains after the end marker count as
+ * Drain. Memory is reserved for stalls on memory accesses, which the
+ * current memory system never causes.
+ */
+enum class CycleCategory : uint8_t {
+  Base,
+  LoadUse,
+  ControlFlush,
+  Structural,
+  Drain,
+  Memory,
+  LAST
+};
+
+static constexpr size_t NumCycleCategories =
+    static_cast<size_t>(CycleCategory::LAST);
+
+/* Whether instructions with this opcode read rs2; used by the hazard
+ * detection.
+ */
+bool instructionUsesRS2(Opcode opcode);
+
+/* The register written by an instruction: rd, or a0 for the result of
+ * ecall.
+ */
+RegNumber destinationRegister(const InstructionDecoder& decoder);
+
 struct PipelineControl {
   void reset()
   {
@@ -73,12 +112,16 @@ struct PipelineControl {
  * the next, these need to be buffered explicitly within the stage.
  */
 struct IF_IDRegisters {
+  uint64_t seq{}; /* fetch sequence number, 0 for bubbles */
   MemAddress PC = 0;
   uint32_t instructionWord = NopInstruction;
+  CycleCategory bubble{CycleCategory::Drain};
 };
 
 struct ID_EXRegisters {
+  uint64_t seq{};
   MemAddress PC{};
+  uint32_t instructionWord{};
   RegValue readData1{};
   RegValue readData2{};
   int64_t immediate{};
@@ -88,22 +131,30 @@ struct ID_EXRegisters {
   Opcode opcode{Opcode::OP};
   uint8_t funct3{};
   ControlSignals control{};
+  CycleCategory bubble{CycleCategory::Drain};
 };
 
 struct EX_MRegisters {
+  uint64_t seq{};
   MemAddress PC{};
+  uint32_t instructionWord{};
   RegValue aluResult{};
   RegValue writeData{}; /* Data to write to memory (rs2 value) */
   RegNumber rd{};
   ControlSignals control{};
+  CycleCategory bubble{CycleCategory::Drain};
 };
 
 struct M_WBRegisters {
+  uint64_t seq{};
   MemAddress PC{};
+  uint32_t instructionWord{};
   RegValue aluResult{};
   RegValue memData{};
+  RegValue writeData{}; /* Data written to memory, kept for tracing */
   RegNumber rd{};
   ControlSignals control{};
+  CycleCategory bubble{CycleCategory::Drain};
 };
 
 /*
@@ -177,6 +228,7 @@ private:
   MemAddress& PC;
   PipelineControl& control;
 
+  uint64_t nextSeq{1};
   MemAddress fetchPC{};
   uint32_t fetchedInstruction{};
   bool endMarkerSeen{};
@@ -194,13 +246,18 @@ public:
                          ID_EXRegisters& id_ex, const M_WBRegisters& m_wb,
                          RegisterFile& regfile, InstructionDecoder& decoder,
                          uint64_t& nInstrIssued, uint64_t& nStalls,
-                         PipelineControl& control, bool debugMode = false)
+                         PipelineControl& control, bool debugMode = false,
+                         const SymbolTable* symbols = nullptr)
       : Stage(pipelining), if_id(if_id), id_ex(id_ex), m_wb(m_wb),
         regfile(regfile), decoder(decoder), nInstrIssued(nInstrIssued),
-        nStalls(nStalls), control(control), debugMode(debugMode)
+        nStalls(nStalls), control(control), debugMode(debugMode),
+        symbols(symbols)
   {
   }
 
+  InstructionDecodeStage(const InstructionDecodeStage&) = delete;
+  InstructionDecodeStage& operator=(const InstructionDecodeStage&) = delete;
+
   void propagate() override;
   void clockPulse() override;
 
@@ -217,9 +274,12 @@ private:
   PipelineControl& control;
 
   bool debugMode;
+  const SymbolTable* symbols; /* no ownership, may be nullptr */
 
+  uint64_t seq{};
   MemAddress PC{};
   uint32_t instructionWord{};
+  CycleCategory bubble{};
   ControlSignals decodedControl{};
   RegValue readData1{};
   RegValue readData2{};
@@ -233,12 +293,15 @@ class ExecuteStage : public Stage {
 public:
   ExecuteStage(bool pipelining, const ID_EXRegisters& id_ex,
                EX_MRegisters& ex_m, const M_WBRegisters& m_wb, MemAddress& PC,
-               PipelineControl& control)
+               PipelineControl& control, CSRFile& csrFile)
       : Stage(pipelining), id_ex(id_ex), ex_m(ex_m), prev_m_wb(m_wb), alu(),
-        PCRef(PC), control(control)
+        PCRef(PC), control(control), csrFile(csrFile)
   {
   }
 
+  ExecuteStage(const ExecuteStage&) = delete;
+  ExecuteStage& operator=(const ExecuteStage&) = delete;
+
   void propagate() override;
   void clockPulse() override;
 
@@ -253,11 +316,19 @@ private:
   bool pcWriteEnable{};
   MemAddress nextPC{};
 
+  CSRFile& csrFile;
+  bool csrWriteEnable{};
+  uint16_t csrNumber{};
+  RegValue csrWriteValue{};
+
+  uint64_t seq{};
   MemAddress PC{};
+  uint32_t instructionWord{};
   RegValue aluResult{};
   RegValue writeData{};
   RegNumber nextRD{};
   ControlSignals nextControl{};
+  CycleCategory bubble{};
 
   bool evaluateBranch(uint8_t funct3, RegValue lhs, RegValue rhs) const;
   MemAddress computePCRelativeTarget(MemAddress base, int64_t offset) const;
@@ -270,11 +341,16 @@ private:
 class MemoryStage : public Stage {
 public:
   MemoryStage(bool pipelining, const EX_MRegisters& ex_m, M_WBRegisters& m_wb,
-              DataMemory dataMemory)
-      : Stage(pipelining), ex_m(ex_m), m_wb(m_wb), dataMemory(dataMemory)
+              DataMemory dataMemory, RegisterFile& regfile,
+              SyscallEmulator& syscalls)
+      : Stage(pipelining), ex_m(ex_m), m_wb(m_wb), dataMemory(dataMemory),
+        regfile(regfile), syscalls(syscalls)
   {
   }
 
+  MemoryStage(const MemoryStage&) = delete;
+  MemoryStage& operator=(const MemoryStage&) = delete;
+
   void propagate() override;
   void clockPulse() override;
 
@@ -284,11 +360,22 @@ private:
 
   DataMemory dataMemory;
 
+  /* System calls are executed here, at the end of the cycle, such that
+   * their effects on memory are ordered like those of stores.
+   */
+  RegisterFile& regfile;
+  SyscallEmulator& syscalls;
+  SyscallArguments syscallArgs{};
+
+  uint64_t seq{};
   MemAddress PC{};
+  uint32_t instructionWord{};
   RegValue aluResult{};
   RegValue memData{};
+  RegValue writeData{};
   RegNumber nextRD{};
   ControlSignals nextControl{};
+  CycleCategory bubble{};
 };
 
 /*
@@ -0,0 +1,78 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    symbol-table.cc - Address to symbol lookup.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "symbol-table.h"
+
+#include <algorithm>
+#include <sstream>
+
+SymbolTable::SymbolTable(std::vector<Symbol>&& symbolList)
+    : symbols{std::move(symbolList)}
+{
+  /* Sort on address, with the preferred symbol first among symbols at
+   * the same address, such that duplicates can be dropped.
+   */
+  std::sort(symbols.begin(), symbols.end(),
+            [](const Symbol& a, const Symbol& b) {
+              if (a.address != b.address)
+                return a.address < b.address;
+              if (a.kind != b.kind)
+                return a.kind > b.kind;
+              return a.name < b.name;
+            });
+
+  symbols.erase(std::unique(symbols.begin(), symbols.end(),
+                            [](const Symbol& a, const Symbol& b) {
+                              return a.address == b.address;
+                            }),
+                symbols.end());
+}
+
+const Symbol*
+SymbolTable::lookup(MemAddress addr) const
+{
+  auto it = std::upper_bound(
+      symbols.begin(), symbols.end(), addr,
+      [](MemAddress value, const Symbol& s) { return value < s.address; });
+
+  if (it == symbols.begin())
+    return nullptr;
+
+  const Symbol& symbol = *std::prev(it);
+  if (symbol.size != 0 && addr - symbol.address >= symbol.size)
+    return nullptr;
+
+  return &symbol;
+}
+
+const Symbol*
+SymbolTable::find(MemAddress addr) const
+{
+  auto it = std::lower_bound(
+      symbols.begin(), symbols.end(), addr,
+      [](const Symbol& s, MemAddress value) { return s.address < value; });
+
+  if (it == symbols.end() || it->address != addr)
+    return nullptr;
+
+  return &*it;
+}
+
+std::string
+SymbolTable::format(MemAddress addr) const
+{
+  const Symbol* symbol = lookup(addr);
+  if (!symbol)
+    return {};
+
+  if (addr == symbol->address)
+    return symbol->name;
+
+  std::stringstream ss;
+  ss << symbol->name << "+0x" << std::hex << addr - symbol->address;
+  return ss.str();
+}
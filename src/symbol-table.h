@@ -0,0 +1,56 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    symbol-table.h - Address to symbol lookup.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __SYMBOL_TABLE_H__
+#define __SYMBOL_TABLE_H__
+
+#include "arch.h"
+
+#include <string>
+#include <vector>
+
+/* The kind of symbol determines which symbol is kept when several
+ * symbols are defined at the same address; higher values win.
+ */
+enum class SymbolKind : uint8_t { Label = 0, Object, Function };
+
+struct Symbol {
+  MemAddress address{};
+  uint64_t size{}; /* zero if unknown, e.g. for assembly labels */
+  SymbolKind kind{};
+  std::string name{};
+};
+
+/* Sorted index of the symbols of a program, which is used to translate
+ * addresses into "function+offset" form. A lookup is a binary search,
+ * so it can be used on hot paths such as debug output.
+ */
+class SymbolTable {
+public:
+  SymbolTable() = default;
+  SymbolTable(std::vector<Symbol>&& symbols);
+
+  bool empty() const { return symbols.empty(); }
+
+  /* Return the symbol that contains addr, or nullptr. A symbol without
+   * size is assumed to extend up to the next symbol.
+   */
+  const Symbol* lookup(MemAddress addr) const;
+
+  /* Return the symbol starting exactly at addr, or nullptr. */
+  const Symbol* find(MemAddress addr) const;
+
+  /* Format addr as "name+0x10", "name" or an empty string when there is
+   * no symbol that covers addr.
+   */
+  std::string format(MemAddress addr) const;
+
+private:
+  std::vector<Symbol> symbols{};
+};
+
+#endif /* __SYMBOL_TABLE_H__ */
@@ -7,10 +7,14 @@
 
 #include "sys-status.h"
 
-#include <iostream>
-
 SysStatus::SysStatus(const MemAddress base) : base{base} {}
 
+void
+SysStatus::setCounterSource(PerfCounterSource source)
+{
+  counterSource = std::move(source);
+}
+
 /*
  * MemoryInterface
  */
@@ -30,22 +34,21 @@ SysStatus::readHalfWord(MemAddress addr)
 uint32_t
 SysStatus::readWord(MemAddress addr)
 {
-  throw IllegalAccess("Not supported on sysstatus interface");
+  return readCounter(addr, sizeof(uint32_t));
 }
 
 uint64_t
 SysStatus::readDoubleWord(MemAddress addr)
 {
-  throw IllegalAccess("Not supported on sysstatus interface");
+  return readCounter(addr, sizeof(uint64_t));
 }
 
 void
 SysStatus::writeByte(MemAddress addr, uint8_t value)
 {
-  if (addr != base + 0x8)
+  if (addr != base + HaltOffset)
     throw IllegalAccess("Invalid system status address");
 
-  std::cerr << "System halt requested." << std::endl;
   shouldHaltFlag = true;
 }
 
@@ -58,10 +61,9 @@ SysStatus::writeHalfWord(MemAddress addr, uint16_t value)
 void
 SysStatus::writeWord(MemAddress addr, uint32_t value)
 {
-  if (addr != base + 0x8)
+  if (addr != base + HaltOffset)
     throw IllegalAccess("Invalid system status address");
 
-  std::cerr << "System halt requested." << std::endl;
   shouldHaltFlag = true;
 }
 
@@ -74,5 +76,33 @@ SysStatus::writeDoubleWord(MemAddress addr, uint64_t value)
 bool
 SysStatus::contains(MemAddress addr) const
 {
-  return base <= addr && addr < base + 0x10;
+  return base <= addr && addr < base + RegionSize;
+}
+
+std::vector<MemoryRegion>
+SysStatus::getRegions() const
+{
+  return {{base, RegionSize}};
+}
+
+/*
+ * Private methods
+ */
+
+uint64_t
+SysStatus::readCounter(MemAddress addr, size_t size) const
+{
+  const MemAddress offset = addr - base;
+  if (offset < CountersOffset || offset >= RegionSize || offset % size != 0)
+    throw IllegalAccess("Invalid system status address");
+  if (!counterSource)
+    throw IllegalAccess("Performance counters not available");
+
+  const size_t index = (offset - CountersOffset) / 8;
+  const uint64_t value = counterSource(static_cast<PerfCounter>(index));
+
+  /* 4-byte loads read either half of the counter */
+  if (size == 4)
+    return static_cast<uint32_t>(value >> (8 * (offset % 8)));
+  return value;
 }
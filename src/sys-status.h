@@ -5,16 +5,18 @@
  * Copyright (C) 2016  Leiden University, The Netherlands.
  */
 
-/* The system status module currently only supports halting the
- * system. Other functionalities could be implemented here at different
- * memory addresses. (For instance, reading the instruction counter,
- * number of clock cycles since start up, etc.).
+/* The system status module supports halting the system, by a store to
+ * base + 0x8, and reading the performance counters of the processor.
+ * The counters are read-only 64-bit registers, starting at base + 0x10
+ * in the order of PerfCounter. A 4-byte load of the upper half of a
+ * counter is also permitted.
  */
 
 #ifndef __SYS_STATUS_H__
 #define __SYS_STATUS_H__
 
 #include "memory-interface.h"
+#include "perf-counter.h"
 
 class SysStatus : public MemoryInterface {
 public:
@@ -23,6 +25,8 @@ public:
 
   bool shouldHalt() const { return shouldHaltFlag; }
 
+  void setCounterSource(PerfCounterSource source);
+
   /* MemoryInterface */
   uint8_t readByte(MemAddress addr) override;
   uint16_t readHalfWord(MemAddress addr) override;
@@ -35,11 +39,19 @@ public:
   void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
   bool contains(MemAddress addr) const override;
+  std::vector<MemoryRegion> getRegions() const override;
 
 private:
+  static constexpr MemAddress HaltOffset = 0x8;
+  static constexpr MemAddress CountersOffset = 0x10;
+  static constexpr size_t RegionSize = CountersOffset + 8 * NumPerfCounters;
+
   const MemAddress base;
 
   bool shouldHaltFlag = false;
+  PerfCounterSource counterSource{};
+
+  uint64_t readCounter(MemAddress addr, size_t size) const;
 };
 
 #endif /* __SYS_STATUS_H__ */
@@ -0,0 +1,543 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    syscalls.cc - Emulation of Linux system calls requested with ECALL.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "syscalls.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _MSC_VER
+#include <io.h>
+
+#define open _open
+#define read _read
+#define write _write
+#define close _close
+#define fstat _fstat
+using HostStat = struct _stat;
+#else
+#include <unistd.h>
+using HostStat = struct stat;
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/* System call numbers of Linux on RV64 */
+constexpr RegValue SysOpenAt = 56;
+constexpr RegValue SysClose = 57;
+constexpr RegValue SysRead = 63;
+constexpr RegValue SysWrite = 64;
+constexpr RegValue SysFstat = 80;
+constexpr RegValue SysExit = 93;
+constexpr RegValue SysExitGroup = 94;
+constexpr RegValue SysClockGetTime = 113;
+constexpr RegValue SysGetTimeOfDay = 169;
+constexpr RegValue SysBrk = 214;
+
+/* Error numbers of Linux, which may differ from those of the host */
+constexpr int64_t GuestENOENT = 2;
+constexpr int64_t GuestEIO = 5;
+constexpr int64_t GuestEBADF = 9;
+constexpr int64_t GuestEACCES = 13;
+constexpr int64_t GuestEFAULT = 14;
+constexpr int64_t GuestEEXIST = 17;
+constexpr int64_t GuestENOTDIR = 20;
+constexpr int64_t GuestEISDIR = 21;
+constexpr int64_t GuestEINVAL = 22;
+constexpr int64_t GuestENOSPC = 28;
+constexpr int64_t GuestENOSYS = 38;
+constexpr int64_t GuestELOOP = 40;
+
+/* Flags of openat */
+constexpr int GuestAtFdCwd = -100;
+constexpr int GuestOAccMode = 03;
+constexpr int GuestOCreat = 0100;
+constexpr int GuestOExcl = 0200;
+constexpr int GuestOTrunc = 01000;
+constexpr int GuestOAppend = 02000;
+
+constexpr RegValue AuxPageSize = 6;
+constexpr size_t PathMax = 4096;
+
+/* struct stat of Linux on RV64 */
+struct GuestStat {
+  uint64_t dev;
+  uint64_t ino;
+  uint32_t mode;
+  uint32_t nlink;
+  uint32_t uid;
+  uint32_t gid;
+  uint64_t rdev;
+  uint64_t pad1;
+  int64_t size;
+  int32_t blksize;
+  int32_t pad2;
+  int64_t blocks;
+  int64_t atime;
+  uint64_t atimeNsec;
+  int64_t mtime;
+  uint64_t mtimeNsec;
+  int64_t ctime;
+  uint64_t ctimeNsec;
+  uint32_t unused4;
+  uint32_t unused5;
+};
+
+static_assert(sizeof(GuestStat) == 128, "struct stat must match the ABI");
+
+/* The negated error number of the last failed host call */
+int64_t
+hostError()
+{
+  switch (errno) {
+  case ENOENT:
+    return -GuestENOENT;
+  case EBADF:
+    return -GuestEBADF;
+  case EACCES:
+    return -GuestEACCES;
+  case EEXIST:
+    return -GuestEEXIST;
+  case ENOTDIR:
+    return -GuestENOTDIR;
+  case EISDIR:
+    return -GuestEISDIR;
+  case EINVAL:
+    return -GuestEINVAL;
+  case ENOSPC:
+    return -GuestENOSPC;
+  case ELOOP:
+    return -GuestELOOP;
+  default:
+    return -GuestEIO;
+  }
+}
+
+int
+translateOpenFlags(int flags)
+{
+  int hostFlags = 0;
+  switch (flags & GuestOAccMode) {
+  case 0:
+    hostFlags = O_RDONLY;
+    break;
+  case 1:
+    hostFlags = O_WRONLY;
+    break;
+  default:
+    hostFlags = O_RDWR;
+    break;
+  }
+
+  if (flags & GuestOCreat)
+    hostFlags |= O_CREAT;
+  if (flags & GuestOExcl)
+    hostFlags |= O_EXCL;
+  if (flags & GuestOTrunc)
+    hostFlags |= O_TRUNC;
+  if (flags & GuestOAppend)
+    hostFlags |= O_APPEND;
+#ifdef _MSC_VER
+  hostFlags |= O_BINARY;
+#else
+  /* The path was resolved within the sandbox. A symbolic link that
+   * replaced the file since must not lead out of it.
+   */
+  hostFlags |= O_NOFOLLOW;
+#endif
+
+  return hostFlags;
+}
+
+} // namespace
+
+SyscallEmulator::SyscallEmulator(MemoryInterface& memory)
+    : memory{memory}, files{0, 1, 2}
+{
+}
+
+SyscallEmulator::~SyscallEmulator()
+{
+  for (size_t fd = 3; fd < files.size(); ++fd)
+    if (files[fd] >= 0)
+      close(files[fd]);
+}
+
+void
+SyscallEmulator::setCounterSource(PerfCounterSource source)
+{
+  counterSource = std::move(source);
+}
+
+void
+SyscallEmulator::setSandbox(const std::string& directory)
+{
+  if (!fs::is_directory(directory))
+    throw std::runtime_error("sandbox " + directory + " is not a directory");
+  sandbox = fs::canonical(directory).string();
+}
+
+void
+SyscallEmulator::setBreak(MemAddress address)
+{
+  initialBreak = address;
+  currentBreak = address;
+}
+
+void
+SyscallEmulator::setWriteObserver(WriteObserver observer)
+{
+  writeObserver = std::move(observer);
+}
+
+MemAddress
+SyscallEmulator::setupStack(MemAddress top,
+                            const std::vector<std::string>& argv,
+                            const std::vector<std::string>& envp)
+{
+  MemAddress addr = top;
+  auto pushString = [this, &addr](const std::string& str) {
+    addr -= str.size() + 1;
+    if (copyToGuest(addr, str.c_str(), str.size() + 1) < 0)
+      throw std::runtime_error("no memory for the program arguments");
+    return addr;
+  };
+
+  std::vector<RegValue> table{argv.size()};
+  for (const auto& arg : argv)
+    table.push_back(pushString(arg));
+  table.push_back(0);
+  for (const auto& var : envp)
+    table.push_back(pushString(var));
+  table.push_back(0);
+
+  /* The auxiliary vector, terminated by AT_NULL */
+  table.insert(table.end(), {AuxPageSize, 4096, 0, 0});
+
+  const MemAddress sp = (addr - table.size() * sizeof(RegValue)) & ~0xFULL;
+  if (copyToGuest(sp, table.data(), table.size() * sizeof(RegValue)) < 0)
+    throw std::runtime_error("no memory for the program arguments");
+
+  return sp;
+}
+
+RegValue
+SyscallEmulator::execute(const SyscallArguments& args)
+{
+  ++nCalls;
+
+  int64_t result = 0;
+  switch (args[7]) {
+  case SysExit:
+  case SysExitGroup:
+    /* Leaves a0 unchanged, the call does not return */
+    exited = true;
+    exitStatus = static_cast<int>(args[0]);
+    result = args[0];
+    break;
+  case SysRead:
+    result = doRead(args[0], args[1], args[2]);
+    break;
+  case SysWrite:
+    result = doWrite(args[0], args[1], args[2]);
+    break;
+  case SysOpenAt:
+    result = doOpenAt(args[0], args[1], args[2], args[3]);
+    break;
+  case SysClose:
+    result = doClose(args[0]);
+    break;
+  case SysFstat:
+    result = doFstat(args[0], args[1]);
+    break;
+  case SysBrk:
+    result = doBrk(args[0]);
+    break;
+  case SysClockGetTime:
+    result = doClockGetTime(args[1]);
+    break;
+  case SysGetTimeOfDay:
+    result = doGetTimeOfDay(args[0]);
+    break;
+  default:
+    result = -GuestENOSYS;
+    break;
+  }
+
+  return static_cast<RegValue>(result);
+}
+
+/*
+ * System calls
+ */
+
+int64_t
+SyscallEmulator::doRead(int fd, MemAddress buf, size_t count)
+{
+  const int file = getHostFile(fd);
+  if (file < 0)
+    return -GuestEBADF;
+
+  /* Show a prompt before waiting for input */
+  if (file == 0)
+    std::cout.flush();
+
+  return forEachRange(
+      buf, count, true, [this, file](std::byte* data, MemAddress addr,
+                                     size_t size) -> int64_t {
+        const auto n = read(file, data, static_cast<unsigned>(size));
+        if (n < 0)
+          return hostError();
+        if (n > 0 && writeObserver)
+          writeObserver(nCalls, addr, data, n);
+        return n;
+      });
+}
+
+int64_t
+SyscallEmulator::doWrite(int fd, MemAddress buf, size_t count)
+{
+  const int file = getHostFile(fd);
+  if (file < 0)
+    return -GuestEBADF;
+
+  /* Keep the order with output written through the streams */
+  if (file == 1)
+    std::cout.flush();
+  else if (file == 2)
+    std::cerr.flush();
+
+  return forEachRange(buf, count, false,
+                      [file](std::byte* data, MemAddress, size_t size) {
+                        const auto n =
+                            write(file, data, static_cast<unsigned>(size));
+                        return n < 0 ? hostError() : int64_t{n};
+                      });
+}
+
+int64_t
+SyscallEmulator::doOpenAt(int dirfd, MemAddress pathname, int flags,
+                          int mode)
+{
+  std::string path;
+  if (!readString(pathname, path))
+    return -GuestEFAULT;
+  if (dirfd != GuestAtFdCwd && !path.empty() && path[0] != '/')
+    return -GuestEBADF;
+  if (sandbox.empty())
+    return -GuestEACCES;
+
+  /* Absolute paths are taken relative to the sandbox as well. Symbolic
+   * links are resolved before checking that the file is inside it.
+   * weakly_canonical() leaves a dangling link at the end of the path
+   * unresolved, which O_CREAT would follow, so such links are refused.
+   */
+  const fs::path relative = fs::path{path}.relative_path().lexically_normal();
+  if (!relative.empty() && *relative.begin() == "..")
+    return -GuestEACCES;
+
+  std::error_code error;
+  const fs::path resolved = fs::weakly_canonical(sandbox / relative, error);
+  if (error)
+    return -GuestENOENT;
+
+  const fs::path root{sandbox};
+  if (std::mismatch(root.begin(), root.end(), resolved.begin(),
+                    resolved.end())
+          .first != root.end())
+    return -GuestEACCES;
+  if (fs::is_symlink(fs::symlink_status(resolved, error)))
+    return -GuestEACCES;
+
+  const int file =
+      open(resolved.string().c_str(), translateOpenFlags(flags), mode);
+  if (file < 0)
+    return hostError();
+
+  auto unused = std::find(files.begin(), files.end(), -1);
+  if (unused == files.end())
+    unused = files.insert(files.end(), -1);
+  *unused = file;
+
+  return unused - files.begin();
+}
+
+int64_t
+SyscallEmulator::doClose(int fd)
+{
+  const int file = getHostFile(fd);
+  if (file < 0)
+    return -GuestEBADF;
+
+  /* The standard streams of the emulator stay open */
+  if (fd > 2)
+    close(file);
+  files[fd] = -1;
+  return 0;
+}
+
+int64_t
+SyscallEmulator::doFstat(int fd, MemAddress statbuf)
+{
+  const int file = getHostFile(fd);
+  if (file < 0)
+    return -GuestEBADF;
+
+  HostStat hostStat;
+  if (fstat(file, &hostStat) < 0)
+    return hostError();
+
+  GuestStat guestStat{};
+  guestStat.dev = hostStat.st_dev;
+  guestStat.ino = hostStat.st_ino;
+  guestStat.mode = hostStat.st_mode;
+  guestStat.nlink = hostStat.st_nlink;
+  guestStat.rdev = hostStat.st_rdev;
+  guestStat.size = hostStat.st_size;
+  guestStat.blksize = 4096;
+  guestStat.blocks = (hostStat.st_size + 511) / 512;
+  guestStat.atime = hostStat.st_atime;
+  guestStat.mtime = hostStat.st_mtime;
+  guestStat.ctime = hostStat.st_ctime;
+
+  if (copyToGuest(statbuf, &guestStat, sizeof(guestStat)) < 0)
+    return -GuestEFAULT;
+  return 0;
+}
+
+/* The heap may only grow over memory that the program can write */
+int64_t
+SyscallEmulator::doBrk(MemAddress address)
+{
+  if (address < initialBreak)
+    return currentBreak;
+
+  if (address > currentBreak) {
+    DirectMemoryRange range;
+    if (!memory.getDirectMemoryRange(currentBreak, range) ||
+        !range.mayWrite || !range.covers(currentBreak, address - currentBreak))
+      return currentBreak;
+  }
+
+  currentBreak = address;
+  return currentBreak;
+}
+
+int64_t
+SyscallEmulator::doClockGetTime(MemAddress tp)
+{
+  const uint64_t ns = getNanoseconds();
+  const int64_t timespec[2] = {static_cast<int64_t>(ns / 1000000000),
+                               static_cast<int64_t>(ns % 1000000000)};
+
+  if (copyToGuest(tp, timespec, sizeof(timespec)) < 0)
+    return -GuestEFAULT;
+  return 0;
+}
+
+int64_t
+SyscallEmulator::doGetTimeOfDay(MemAddress tv)
+{
+  const uint64_t ns = getNanoseconds();
+  const int64_t timeval[2] = {static_cast<int64_t>(ns / 1000000000),
+                              static_cast<int64_t>(ns % 1000000000 / 1000)};
+
+  if (tv != 0 && copyToGuest(tv, timeval, sizeof(timeval)) < 0)
+    return -GuestEFAULT;
+  return 0;
+}
+
+/*
+ * Helpers
+ */
+
+int
+SyscallEmulator::getHostFile(int fd) const
+{
+  if (fd < 0 || static_cast<size_t>(fd) >= files.size())
+    return -1;
+  return files[fd];
+}
+
+uint64_t
+SyscallEmulator::getNanoseconds() const
+{
+  return counterSource ? counterSource(PerfCounter::Cycles) : 0;
+}
+
+template <typename Transfer>
+int64_t
+SyscallEmulator::forEachRange(MemAddress addr, size_t size, bool toGuest,
+                              Transfer transfer)
+{
+  int64_t done = 0;
+
+  while (size > 0) {
+    DirectMemoryRange range;
+    if (!memory.getDirectMemoryRange(addr, range) || !range.covers(addr, 1) ||
+        (toGuest && !range.mayWrite))
+      return done > 0 ? done : -GuestEFAULT;
+
+    const size_t offset = addr - range.base;
+    const size_t n = std::min<uint64_t>(size, range.size - offset);
+    const int64_t count = transfer(range.data + offset, addr, n);
+    if (count < 0)
+      return done > 0 ? done : count;
+
+    done += count;
+    if (static_cast<size_t>(count) < n)
+      break;
+
+    addr += n;
+    size -= n;
+  }
+
+  return done;
+}
+
+int64_t
+SyscallEmulator::copyToGuest(MemAddress addr, const void* data, size_t size)
+{
+  const std::byte* src = static_cast<const std::byte*>(data);
+  const int64_t count = forEachRange(
+      addr, size, true, [this, &src](std::byte* dst, MemAddress at, size_t n) {
+        std::memcpy(dst, src, n);
+        src += n;
+        if (writeObserver)
+          writeObserver(nCalls, at, dst, n);
+        return static_cast<int64_t>(n);
+      });
+
+  return count == static_cast<int64_t>(size) ? count : -GuestEFAULT;
+}
+
+bool
+SyscallEmulator::readString(MemAddress addr, std::string& str)
+{
+  bool terminated = false;
+  str.clear();
+
+  forEachRange(addr, PathMax, false,
+               [&str, &terminated](std::byte* data, MemAddress, size_t n) {
+                 const char* chars = reinterpret_cast<const char*>(data);
+                 const size_t length = strnlen(chars, n);
+                 str.append(chars, length);
+                 terminated = length < n;
+                 return static_cast<int64_t>(length);
+               });
+
+  return terminated;
+}
@@ -0,0 +1,118 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    syscalls.h - Emulation of Linux system calls requested with ECALL.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __SYSCALLS_H__
+#define __SYSCALLS_H__
+
+#include "arch.h"
+#include "memory-interface.h"
+#include "perf-counter.h"
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* The argument registers a0-a7 of a system call. a7 holds the number of
+ * the system call, the result is returned in a0.
+ */
+static constexpr RegNumber SyscallFirstArgument = 10;
+using SyscallArguments = std::array<RegValue, 8>;
+
+/* Executes the system calls of programs linked against newlib or a
+ * similar C library, like a proxy kernel does: the calls are served by
+ * the host, using the numbers and structures of Linux on RV64.
+ *
+ * Supported are exit, read, write, close, fstat, brk, openat,
+ * clock_gettime and gettimeofday. Other calls fail with ENOSYS. The
+ * standard streams of the program are those of the emulator. openat
+ * only opens files within the sandbox directory, when one was set. Time
+ * is derived from the simulated clock cycles, at one cycle per
+ * nanosecond. Data is copied directly between host buffers and the
+ * memory of the program, without going through the memory bus.
+ */
+class SyscallEmulator {
+public:
+  SyscallEmulator(MemoryInterface& memory);
+  ~SyscallEmulator();
+
+  SyscallEmulator(const SyscallEmulator&) = delete;
+  SyscallEmulator& operator=(const SyscallEmulator&) = delete;
+
+  void setCounterSource(PerfCounterSource source);
+
+  /* Files may only be opened within directory */
+  void setSandbox(const std::string& directory);
+
+  /* The initial program break, where brk starts to grow the heap */
+  void setBreak(MemAddress address);
+
+  /* Reports the memory written on behalf of the program, for the
+   * co-simulation. index is the number of the system call that wrote
+   * it, counting from one, or zero for the initial stack.
+   */
+  using WriteObserver = std::function<void(uint64_t index, MemAddress addr,
+                                           const std::byte* data, size_t size)>;
+  void setWriteObserver(WriteObserver observer);
+
+  /* Build the initial stack of a program below top: argc, the argv and
+   * envp pointer arrays and an auxiliary vector, followed by the
+   * strings. Returns the stack pointer.
+   */
+  MemAddress setupStack(MemAddress top, const std::vector<std::string>& argv,
+                        const std::vector<std::string>& envp);
+
+  /* Execute a system call, returns the value for a0 */
+  RegValue execute(const SyscallArguments& args);
+
+  bool hasExited() const { return exited; }
+  int getExitStatus() const { return exitStatus; }
+
+private:
+  MemoryInterface& memory;
+  PerfCounterSource counterSource{};
+  WriteObserver writeObserver{};
+  std::string sandbox{};
+
+  /* Host file descriptors of the program's files, indexed by the
+   * program's file descriptor; -1 for unused entries.
+   */
+  std::vector<int> files{};
+
+  MemAddress initialBreak{};
+  MemAddress currentBreak{};
+
+  uint64_t nCalls{};
+  bool exited{};
+  int exitStatus{};
+
+  int64_t doRead(int fd, MemAddress buf, size_t count);
+  int64_t doWrite(int fd, MemAddress buf, size_t count);
+  int64_t doOpenAt(int dirfd, MemAddress pathname, int flags, int mode);
+  int64_t doClose(int fd);
+  int64_t doFstat(int fd, MemAddress statbuf);
+  int64_t doBrk(MemAddress address);
+  int64_t doClockGetTime(MemAddress tp);
+  int64_t doGetTimeOfDay(MemAddress tv);
+
+  int getHostFile(int fd) const;
+  uint64_t getNanoseconds() const;
+
+  /* Call transfer(hostPointer, guestAddress, size) for the parts of the
+   * guest range that lie in consecutive direct memory ranges, until it
+   * transfers fewer bytes than requested. Returns the number of bytes
+   * transferred, or -EFAULT when nothing could be accessed.
+   */
+  template <typename Transfer>
+  int64_t forEachRange(MemAddress addr, size_t size, bool toGuest,
+                       Transfer transfer);
+
+  int64_t copyToGuest(MemAddress addr, const void* data, size_t size);
+  bool readString(MemAddress addr, std::string& str);
+};
+
+#endif /* __SYSCALLS_H__ */
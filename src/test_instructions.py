@@ -73,6 +73,12 @@ parser.add_argument(
 parser.add_argument(
     "-p", dest="pipeline", action="store_true", help="Enable pipelining on emulator"
 )
+parser.add_argument(
+    "-o",
+    dest="outoforder",
+    action="store_true",
+    help="Run on the out-of-order core of the emulator",
+)
 parser.add_argument(
     "testfile",
     type=str,
@@ -104,6 +110,8 @@ print()
 # Run the tests
 if args.pipeline:
     cmd = [str(RV64_EMU), "-p", "-t"]
+elif args.outoforder:
+    cmd = [str(RV64_EMU), "-o", "-t"]
 else:
     cmd = [str(RV64_EMU), "-t"]
 
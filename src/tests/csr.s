@@ -0,0 +1,17 @@
+# Test of the Zicsr instructions on the counter CSRs. The counters
+# themselves depend on timing, so only values written by the program
+# are checked: a written mhpmcounter3 that does not count any event yet,
+# and the event selection of mhpmevent3.
+
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	csrw	mhpmcounter3,x1		# 42, counts nothing
+	csrr	x2,hpmcounter3		# 42
+	csrrwi	x3,mhpmevent3,6		# 0, now counts bytes written
+	csrrci	x4,mhpmevent3,2		# 6, now counts stalls
+	csrr	x5,mhpmevent3		# 4
+	.word	0xddffccff
+	.size	_start, .-_start
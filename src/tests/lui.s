@@ -0,0 +1,16 @@
+	.text
+        .align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	lui	x1,0x80000
+	lui	x2,0xfffff
+	auipc	x3,0x80000
+	lui	x4,0x7ffff
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+	.size	_start, .-_start
@@ -0,0 +1,17 @@
+	.text
+        .align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	slli	x2,x1,40
+	srli	x3,x1,57
+	srai	x4,x1,63
+	srai	x5,x1,35
+	slli	x6,x1,31
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+	.size	_start, .-_start
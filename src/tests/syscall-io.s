@@ -0,0 +1,90 @@
+# Test of the system calls whose results do not depend on the host or
+# the command line: writes, reads and fstat of unknown descriptors and
+# bad buffers, openat without a sandbox, the time calls, which count
+# simulated cycles, and brk without RAM to grow the heap into.
+
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	li	a0,1
+	la	a1,message
+	li	a2,3
+	li	a7,64
+	ecall				# write(1, "ok\n", 3)
+	mv	x5,a0			# 3
+	li	a0,7
+	la	a1,message
+	li	a2,3
+	li	a7,64
+	ecall				# write(7, ...), -EBADF
+	mv	x6,a0			# -9
+	li	a0,1
+	li	a1,0x100
+	li	a2,3
+	li	a7,64
+	ecall				# write(1, unmapped, 3), -EFAULT
+	mv	x7,a0			# -14
+	li	a0,7
+	la	a1,buffer
+	li	a2,4
+	li	a7,63
+	ecall				# read(7, ...), -EBADF
+	mv	x8,a0			# -9
+	li	a0,7
+	la	a1,buffer
+	li	a7,80
+	ecall				# fstat(7, ...), -EBADF
+	mv	x9,a0			# -9
+	li	a0,-100
+	la	a1,path
+	li	a2,0
+	li	a7,56
+	ecall				# openat(AT_FDCWD, "file", 0), -EACCES
+	mv	x18,a0			# -13
+	li	a0,1
+	la	a1,buffer
+	li	a7,113
+	ecall				# clock_gettime(CLOCK_MONOTONIC, ...)
+	mv	x19,a0			# 0
+	ld	x20,0(a1)		# 0 seconds
+	ld	x25,8(a1)
+	snez	x21,x25			# nanoseconds counted
+	li	a0,0
+	li	a7,214
+	ecall				# brk(0)
+	mv	x26,a0
+	addi	a0,x26,-8
+	li	a7,214
+	ecall				# brk below the initial break, refused
+	sub	x22,a0,x26		# 0
+	li	a0,0x100000
+	add	a0,x26,a0
+	li	a7,214
+	ecall				# brk beyond the program, refused
+	sub	x23,a0,x26		# 0
+	la	a0,buffer
+	li	a1,0
+	li	a7,169
+	ecall				# gettimeofday(...)
+	mv	x24,a0			# 0
+	li	a0,0
+	li	a7,93
+	ecall				# exit(0)
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+	.size	_start, .-_start
+
+	.data
+message:
+	.string	"ok\n"
+path:
+	.string	"file"
+	.align	3
+buffer:
+	.zero	128
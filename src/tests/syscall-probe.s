@@ -0,0 +1,357 @@
+# Probes of the system calls that depend on the command line or on the
+# files of the host, used by testdata/syscall-*.test. The first argument
+# selects the probe:
+#
+#   args     prints argc, argv, envp and the auxiliary vector
+#   brk      grows and shrinks the heap, which needs RAM (-m)
+#   sandbox  opens files in and around the sandbox (-S)
+
+	.equ	SYS_OPENAT, 56
+	.equ	SYS_CLOSE, 57
+	.equ	SYS_READ, 63
+	.equ	SYS_WRITE, 64
+	.equ	SYS_FSTAT, 80
+	.equ	SYS_EXIT, 93
+	.equ	SYS_BRK, 214
+	.equ	AT_FDCWD, -100
+	.equ	O_WRONLY, 1
+	.equ	O_CREAT, 0100
+
+	.text
+	.align	2
+
+# Write the zero-terminated string at a0 to standard output
+	.type	print_string, @function
+print_string:
+	mv	a1, a0
+	li	a2, 0
+1:	add	t0, a1, a2
+	lbu	t0, 0(t0)
+	beqz	t0, 2f
+	addi	a2, a2, 1
+	j	1b
+2:	li	a0, 1
+	li	a7, SYS_WRITE
+	ecall
+	ret
+	.size	print_string, .-print_string
+
+# Print a0 as a signed decimal number, followed by a newline
+	.type	print_number, @function
+print_number:
+	la	t0, number_end
+	li	t1, '\n'
+	sb	t1, 0(t0)
+	mv	t2, a0
+	bgez	t2, 1f
+	neg	t2, t2
+	# Digits from the least significant one, by repeated subtraction
+1:	li	t3, 0
+2:	li	t4, 10
+	bltu	t2, t4, 3f
+	addi	t2, t2, -10
+	addi	t3, t3, 1
+	j	2b
+3:	addi	t2, t2, '0'
+	addi	t0, t0, -1
+	sb	t2, 0(t0)
+	mv	t2, t3
+	bnez	t2, 1b
+	bgez	a0, 4f
+	addi	t0, t0, -1
+	li	t1, '-'
+	sb	t1, 0(t0)
+4:	mv	a0, t0
+	j	print_string
+	.size	print_number, .-print_number
+
+# Print the label at a0, then the number a1
+	.type	print_field, @function
+print_field:
+	addi	sp, sp, -16
+	sd	ra, 0(sp)
+	sd	a1, 8(sp)
+	call	print_string
+	ld	a0, 8(sp)
+	call	print_number
+	ld	ra, 0(sp)
+	addi	sp, sp, 16
+	ret
+	.size	print_field, .-print_field
+
+# Return in a0 whether the strings at a0 and a1 are equal
+	.type	string_equal, @function
+string_equal:
+1:	lbu	t0, 0(a0)
+	lbu	t1, 0(a1)
+	bne	t0, t1, 2f
+	addi	a0, a0, 1
+	addi	a1, a1, 1
+	bnez	t0, 1b
+	li	a0, 1
+	ret
+2:	li	a0, 0
+	ret
+	.size	string_equal, .-string_equal
+
+	.type	probe_args, @function
+probe_args:
+	la	a0, label_argc
+	mv	a1, s0
+	call	print_field
+	mv	s2, s1
+1:	ld	s3, 0(s2)
+	beqz	s3, 2f
+	la	a0, label_argv
+	call	print_string
+	mv	a0, s3
+	call	print_string
+	la	a0, newline
+	call	print_string
+	addi	s2, s2, 8
+	j	1b
+2:	addi	s2, s2, 8
+3:	ld	s3, 0(s2)
+	beqz	s3, 4f
+	la	a0, label_envp
+	call	print_string
+	mv	a0, s3
+	call	print_string
+	la	a0, newline
+	call	print_string
+	addi	s2, s2, 8
+	j	3b
+4:	addi	s2, s2, 8
+5:	ld	s3, 0(s2)
+	la	a0, label_auxv
+	mv	a1, s3
+	call	print_field
+	ld	a1, 8(s2)
+	la	a0, label_value
+	call	print_field
+	addi	s2, s2, 16
+	bnez	s3, 5b
+	la	a0, label_align
+	andi	a1, sp, 15
+	call	print_field
+	li	a0, 0
+	j	exit
+	.size	probe_args, .-probe_args
+
+# Prints the break relative to the initial one after every call
+	.type	probe_brk, @function
+probe_brk:
+	li	a0, 0
+	li	a7, SYS_BRK
+	ecall
+	mv	s2, a0
+	li	t0, 0x40000000
+	sub	a1, a0, t0
+	la	a0, label_initial
+	call	print_field
+	li	t0, 0x1000
+	add	a0, s2, t0
+	li	a7, SYS_BRK
+	ecall				# grow by a page
+	sub	a1, a0, s2
+	la	a0, label_grow
+	call	print_field
+	li	t0, 0xff8
+	add	t0, s2, t0
+	li	t1, 42
+	sd	t1, 0(t0)		# the new heap is usable
+	ld	a1, 0(t0)
+	la	a0, label_store
+	call	print_field
+	addi	a0, s2, -8
+	li	a7, SYS_BRK
+	ecall				# below the initial break
+	sub	a1, a0, s2
+	la	a0, label_below
+	call	print_field
+	li	t0, 0x10008
+	add	a0, s2, t0
+	li	a7, SYS_BRK
+	ecall				# beyond the end of the RAM
+	sub	a1, a0, s2
+	la	a0, label_beyond
+	call	print_field
+	mv	a0, s2
+	li	a7, SYS_BRK
+	ecall				# shrink to the initial break
+	sub	a1, a0, s2
+	la	a0, label_shrink
+	call	print_field
+	li	a0, 0
+	j	exit
+	.size	probe_brk, .-probe_brk
+
+# Open the path at s2 with flags s3 and print the result. Files that
+# were opened are read, their size is printed and they are closed.
+	.type	try_open, @function
+try_open:
+	addi	sp, sp, -16
+	sd	ra, 0(sp)
+	mv	a0, s2
+	call	print_string
+	li	a0, AT_FDCWD
+	mv	a1, s2
+	mv	a2, s3
+	li	a7, SYS_OPENAT
+	ecall
+	mv	s4, a0
+	mv	a1, a0
+	la	a0, label_result
+	call	print_field
+	bltz	s4, 2f
+	mv	a0, s4
+	la	a1, buffer
+	li	a7, SYS_FSTAT
+	ecall
+	la	a0, label_size
+	ld	a1, buffer + 48
+	call	print_field
+	mv	a0, s4
+	la	a1, buffer
+	li	a2, 64
+	li	a7, SYS_READ
+	ecall
+	blez	a0, 1f
+	mv	a2, a0
+	li	a0, 1
+	la	a1, buffer
+	li	a7, SYS_WRITE
+	ecall
+1:	mv	a0, s4
+	li	a7, SYS_CLOSE
+	ecall
+2:	ld	ra, 0(sp)
+	addi	sp, sp, 16
+	ret
+	.size	try_open, .-try_open
+
+	.type	probe_sandbox, @function
+probe_sandbox:
+	li	s3, 0
+	la	s2, path_hello
+	call	try_open
+	la	s2, path_absolute
+	call	try_open
+	la	s2, path_dotdot_inside
+	call	try_open
+	la	s2, path_dotdot_outside
+	call	try_open
+	la	s2, path_link_out
+	call	try_open
+	la	s2, path_missing
+	call	try_open
+	li	s3, O_WRONLY | O_CREAT
+	la	s2, path_dangling
+	call	try_open
+	li	a0, 5			# not an open directory
+	la	a1, path_hello
+	li	a2, 0
+	li	a7, SYS_OPENAT
+	ecall
+	mv	a1, a0
+	la	a0, label_dirfd
+	call	print_field
+	li	a0, 0
+	j	exit
+	.size	probe_sandbox, .-probe_sandbox
+
+	.globl	_start
+	.type	_start, @function
+_start:
+	ld	s0, 0(sp)		# argc
+	addi	s1, sp, 8		# argv
+	li	t0, 2
+	blt	s0, t0, usage
+	ld	s2, 8(s1)
+	mv	a0, s2
+	la	a1, name_args
+	call	string_equal
+	bnez	a0, probe_args
+	mv	a0, s2
+	la	a1, name_brk
+	call	string_equal
+	bnez	a0, probe_brk
+	mv	a0, s2
+	la	a1, name_sandbox
+	call	string_equal
+	bnez	a0, probe_sandbox
+usage:
+	li	a0, 2
+exit:
+	li	a7, SYS_EXIT
+	ecall
+	nop
+	nop
+	nop
+	nop
+	nop
+	nop
+	.size	_start, .-_start
+
+	.section .rodata
+name_args:
+	.string	"args"
+name_brk:
+	.string	"brk"
+name_sandbox:
+	.string	"sandbox"
+label_argc:
+	.string	"argc "
+label_argv:
+	.string	"argv "
+label_envp:
+	.string	"envp "
+label_auxv:
+	.string	"auxv "
+label_value:
+	.string	"  value "
+label_align:
+	.string	"sp % 16 = "
+label_initial:
+	.string	"initial break - RAM base = "
+label_grow:
+	.string	"grow by 4096: "
+label_store:
+	.string	"load from new heap: "
+label_below:
+	.string	"below initial break: "
+label_beyond:
+	.string	"beyond RAM: "
+label_shrink:
+	.string	"shrink: "
+label_result:
+	.string	": "
+label_size:
+	.string	"size "
+label_dirfd:
+	.string	"openat(5, hello.txt): "
+newline:
+	.string	"\n"
+path_hello:
+	.string	"hello.txt"
+path_absolute:
+	.string	"/hello.txt"
+path_dotdot_inside:
+	.string	"sub/../hello.txt"
+path_dotdot_outside:
+	.string	"../sandbox-outside.txt"
+path_link_out:
+	.string	"link-out"
+path_missing:
+	.string	"missing.txt"
+path_dangling:
+	.string	"dangling"
+
+	.data
+	.align	3
+buffer:
+	.zero	128
+number:
+	.zero	24
+number_end:
+	.zero	2			# newline and terminator
@@ -0,0 +1,22 @@
+# Test of system calls whose results do not depend on the host: an
+# unknown call, closing a file that is not open and exit, which stops
+# the program before the instruction that follows it.
+
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	li	a7,999
+	ecall				# -ENOSYS
+	addi	x5,a0,0			# -38, result used right away
+	li	a0,7
+	li	a7,57
+	ecall				# close(7), -EBADF
+	mv	x6,a0			# -9
+	li	a0,3
+	li	a7,93
+	ecall				# exit(3)
+	li	x7,1			# not executed
+	.word	0xddffccff
+	.size	_start, .-_start
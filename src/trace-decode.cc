@@ -0,0 +1,77 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    trace-decode.cc - Print a binary execution trace as text.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "inst-decoder.h"
+#include "trace.h"
+
+#include <iomanip>
+#include <iostream>
+
+/* Print a record on a single line: PC, instruction word, disassembly,
+ * followed by the register write and memory access if any.
+ */
+static void
+printRecord(std::ostream& os, InstructionDecoder& decoder,
+            const TraceRecord& record)
+{
+  auto storeFlags(os.flags());
+  os << std::hex << "0x" << record.PC << "\t0x" << std::setfill('0')
+     << std::setw(8) << record.instructionWord << "\t";
+  os.flags(storeFlags);
+
+  decoder.setInstructionWord(record.instructionWord);
+  try {
+    os << decoder;
+  } catch (IllegalInstruction&) {
+    os << "illegal instruction";
+  }
+
+  os << std::hex;
+  if (record.writesRD)
+    os << "\tr" << std::dec << static_cast<int>(record.rd) << std::hex
+       << " = 0x" << record.rdValue;
+
+  if (record.access != TraceRecord::Access::None) {
+    os << (record.access == TraceRecord::Access::Load ? "\tload" : "\tstore")
+       << std::dec << static_cast<int>(record.size) << std::hex << " [0x"
+       << record.address << "] 0x" << record.data;
+  }
+  os.flags(storeFlags);
+
+  if (record.halt)
+    os << "\thalt";
+
+  os << '\n';
+}
+
+int
+main(int argc, char** argv)
+{
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <traceFilename>" << std::endl;
+    return 1;
+  }
+
+  try {
+    TraceReader reader(argv[1]);
+    InstructionDecoder decoder;
+    TraceRecord record;
+    uint64_t count = 0;
+
+    while (reader.next(record)) {
+      printRecord(std::cout, decoder, record);
+      ++count;
+    }
+
+    std::cout << std::dec << count << " records." << std::endl;
+  } catch (std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
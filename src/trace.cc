@@ -0,0 +1,284 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    trace.cc - Binary execution trace.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+using namespace TraceFormat;
+
+static size_t
+encodeVarint(uint8_t* out, uint64_t value)
+{
+  size_t n = 0;
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value != 0)
+      byte |= 0x80;
+    out[n++] = byte;
+  } while (value != 0);
+
+  return n;
+}
+
+static uint8_t
+encodeSize(uint8_t size)
+{
+  switch (size) {
+  case 2:
+    return 1;
+  case 4:
+    return 2;
+  case 8:
+    return 3;
+  default:
+    return 0;
+  }
+}
+
+/*
+ * TraceWriter
+ */
+
+TraceWriter::TraceWriter(const std::string& filename, size_t bufferSize)
+    : file{filename, std::ios::binary | std::ios::trunc},
+      buffer{}, bufferSize{std::max<size_t>(bufferSize, 4 * MaxRecordSize)}
+{
+  if (!file)
+    throw std::runtime_error("cannot open trace output file " + filename);
+
+  if ((this->bufferSize & (this->bufferSize - 1)) != 0)
+    throw std::invalid_argument("trace buffer size must be a power of two");
+
+  buffer = std::make_unique<uint8_t[]>(this->bufferSize);
+
+  file.write(Magic, sizeof(Magic));
+
+  writer = std::thread(&TraceWriter::writeLoop, this);
+}
+
+TraceWriter::~TraceWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wakeup.notify_one();
+  writer.join();
+
+  file.flush();
+}
+
+void
+TraceWriter::record(const TraceRecord& entry)
+{
+  uint8_t encoded[MaxRecordSize];
+  size_t n = 1;
+
+  uint8_t flags = 0;
+  if (entry.PC == lastPC + 4)
+    flags |= FlagSequential;
+  else {
+    const int64_t delta = static_cast<int64_t>(entry.PC - lastPC);
+    const uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^
+                            static_cast<uint64_t>(delta >> 63);
+    n += encodeVarint(&encoded[n], zigzag);
+  }
+  lastPC = entry.PC;
+
+  for (size_t i = 0; i < sizeof(uint32_t); ++i)
+    encoded[n++] = static_cast<uint8_t>(entry.instructionWord >> (8 * i));
+
+  if (entry.writesRD) {
+    flags |= FlagWritesRD;
+    encoded[n++] = entry.rd;
+    n += encodeVarint(&encoded[n], entry.rdValue);
+  }
+
+  if (entry.access != TraceRecord::Access::None) {
+    flags |= entry.access == TraceRecord::Access::Load ? FlagLoad : FlagStore;
+    flags |= encodeSize(entry.size) << SizeShift;
+    n += encodeVarint(&encoded[n], entry.address);
+
+    /* Only the accessed bytes are kept, sign extension is dropped. */
+    RegValue data = entry.data;
+    if (entry.size < sizeof(RegValue))
+      data &= (RegValue{1} << (8 * entry.size)) - 1;
+    n += encodeVarint(&encoded[n], data);
+  }
+
+  encoded[0] = flags;
+
+  push(encoded, n);
+  ++nRecords;
+}
+
+void
+TraceWriter::recordHalt()
+{
+  push(&HaltMarker, 1);
+}
+
+void
+TraceWriter::push(const uint8_t* data, size_t n)
+{
+  /* Wait for space in the ring buffer, only when the writer falls
+   * behind.
+   */
+  const size_t h = head.load(std::memory_order_relaxed);
+  while (bufferSize - (h - tail.load(std::memory_order_acquire)) < n) {
+    wakeup.notify_one();
+    std::this_thread::yield();
+  }
+
+  const size_t mask = bufferSize - 1;
+  const size_t first = std::min(n, bufferSize - (h & mask));
+  std::memcpy(&buffer[h & mask], data, first);
+  std::memcpy(&buffer[0], data + first, n - first);
+
+  head.store(h + n, std::memory_order_release);
+
+  /* Wake up the writer once the buffer becomes half full. */
+  const size_t used = h + n - tail.load(std::memory_order_relaxed);
+  if (used >= bufferSize / 2 && used - n < bufferSize / 2)
+    wakeup.notify_one();
+}
+
+void
+TraceWriter::drain()
+{
+  const size_t mask = bufferSize - 1;
+  size_t t = tail.load(std::memory_order_relaxed);
+  const size_t h = head.load(std::memory_order_acquire);
+
+  while (t != h) {
+    const size_t chunk = std::min(h - t, bufferSize - (t & mask));
+    file.write(reinterpret_cast<const char*>(&buffer[t & mask]), chunk);
+    t += chunk;
+    tail.store(t, std::memory_order_release);
+  }
+}
+
+void
+TraceWriter::writeLoop()
+{
+  using namespace std::chrono_literals;
+
+  while (!stopping) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wakeup.wait_for(lock, 10ms, [this] { return stopping.load(); });
+    }
+    drain();
+  }
+
+  drain();
+}
+
+/*
+ * TraceReader
+ */
+
+TraceReader::TraceReader(const std::string& filename)
+    : file{filename, std::ios::binary}, buffer(1 << 16)
+{
+  if (!file)
+    throw std::runtime_error("cannot open trace file " + filename);
+
+  char magic[sizeof(Magic)];
+  if (!file.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, Magic, sizeof(Magic)) != 0)
+    throw std::invalid_argument("not a rv64-emu trace file");
+}
+
+/* Make sure at least one byte is buffered; returns false at the end of
+ * the file.
+ */
+bool
+TraceReader::fill()
+{
+  if (position < available)
+    return true;
+
+  file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+  available = file.gcount();
+  position = 0;
+
+  return available > 0;
+}
+
+uint8_t
+TraceReader::readByte()
+{
+  if (!fill())
+    throw std::runtime_error("truncated trace record");
+  return buffer[position++];
+}
+
+uint64_t
+TraceReader::readVarint()
+{
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    const uint8_t byte = readByte();
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+
+  throw std::runtime_error("malformed trace record");
+}
+
+bool
+TraceReader::next(TraceRecord& record)
+{
+  if (!fill())
+    return false;
+
+  const uint8_t flags = readByte();
+  if (flags == HaltMarker)
+    return next(record);
+
+  record = TraceRecord{};
+  if (flags & FlagSequential)
+    record.PC = lastPC + 4;
+  else {
+    const uint64_t zigzag = readVarint();
+    const int64_t delta =
+        static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+    record.PC = lastPC + delta;
+  }
+  lastPC = record.PC;
+
+  for (size_t i = 0; i < sizeof(uint32_t); ++i)
+    record.instructionWord |= static_cast<uint32_t>(readByte()) << (8 * i);
+
+  if (flags & FlagWritesRD) {
+    record.writesRD = true;
+    record.rd = readByte();
+    record.rdValue = readVarint();
+  }
+
+  if (flags & (FlagLoad | FlagStore)) {
+    record.access = flags & FlagLoad ? TraceRecord::Access::Load
+                                     : TraceRecord::Access::Store;
+    record.size = 1 << ((flags >> SizeShift) & 0x3);
+    record.address = readVarint();
+    record.data = readVarint();
+  }
+
+  if (fill() && buffer[position] == HaltMarker) {
+    ++position;
+    record.halt = true;
+  }
+
+  return true;
+}
@@ -0,0 +1,127 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    trace.h - Binary execution trace.
+ *
+ * Copyright (C) 2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "arch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* One record per retired instruction. */
+struct TraceRecord {
+  enum class Access : uint8_t { None = 0, Load, Store };
+
+  MemAddress PC{};
+  uint32_t instructionWord{};
+
+  bool writesRD{};
+  RegNumber rd{};
+  RegValue rdValue{};
+
+  Access access{Access::None};
+  uint8_t size{}; /* access size in bytes: 1, 2, 4 or 8 */
+  MemAddress address{};
+  RegValue data{}; /* loaded or stored value */
+
+  bool halt{}; /* the machine halted after this instruction */
+};
+
+/* The trace file starts with an 8 byte magic, followed by the records.
+ * Every record starts with a flags byte. Unless the record's PC follows
+ * the PC of the previous record, the PC is stored as a signed delta.
+ * Then follows the instruction word and, depending on the flags, the
+ * destination register and its value and the memory access. Variable
+ * length fields use LEB128 encoding, such that most records take 5 to
+ * 10 bytes. When the program requested a halt, the final record is
+ * followed by a single HaltMarker byte.
+ */
+namespace TraceFormat {
+static constexpr char Magic[8] = {'R', 'V', '6', '4', 'T', 'R', 'C', '1'};
+
+static constexpr uint8_t FlagSequential = 0x01;
+static constexpr uint8_t FlagWritesRD = 0x02;
+static constexpr uint8_t FlagLoad = 0x04;
+static constexpr uint8_t FlagStore = 0x08;
+static constexpr uint8_t SizeShift = 4; /* log2 of the size, 2 bits */
+
+static constexpr uint8_t HaltMarker = 0x80;
+
+static constexpr size_t MaxRecordSize = 64;
+} // namespace TraceFormat
+
+/* Records are encoded by the simulation thread into a ring buffer,
+ * which is drained to the trace file by a background writer thread.
+ * The ring buffer has a single producer and a single consumer, so the
+ * simulation thread only blocks when the writer cannot keep up.
+ */
+class TraceWriter {
+public:
+  TraceWriter(const std::string& filename, size_t bufferSize = 1 << 20);
+  ~TraceWriter();
+
+  TraceWriter(const TraceWriter&) = delete;
+  TraceWriter& operator=(const TraceWriter&) = delete;
+
+  void record(const TraceRecord& entry);
+
+  /* Mark that the last recorded instruction halted the machine. */
+  void recordHalt();
+
+  uint64_t getRecordsWritten() const { return nRecords; }
+
+private:
+  std::ofstream file;
+
+  std::unique_ptr<uint8_t[]> buffer;
+  const size_t bufferSize;    /* power of two */
+  std::atomic<size_t> head{}; /* written by producer */
+  std::atomic<size_t> tail{}; /* written by consumer */
+  std::atomic<bool> stopping{};
+
+  std::mutex mutex{};
+  std::condition_variable wakeup{};
+  std::thread writer{};
+
+  MemAddress lastPC{};
+  uint64_t nRecords{};
+
+  void push(const uint8_t* data, size_t n);
+  void drain();
+  void writeLoop();
+};
+
+/* Sequential reader for trace files, used by the trace decoder. */
+class TraceReader {
+public:
+  TraceReader(const std::string& filename);
+
+  /* Read the next record; returns false at the end of the trace. */
+  bool next(TraceRecord& record);
+
+private:
+  std::ifstream file;
+  std::vector<uint8_t> buffer;
+  size_t position{};
+  size_t available{};
+
+  MemAddress lastPC{};
+
+  bool fill();
+  uint64_t readVarint();
+  uint8_t readByte();
+};
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,92 @@
+# Start-up code for the benchmarks: sets up a stack, calls main and
+# prints the checksum it returns on the serial device, such that a run
+# can be validated, and halts the system.
+#
+# Also provides __muldi3, which the compiler calls for multiplications
+# on RV64I. _start comes last and ends in nops, such that the pipeline
+# never fetches beyond the end of the text segment.
+
+	.equ	SERIAL, 0x200
+	.equ	SYS_HALT, 0x278
+	.equ	STACK_SIZE, 16384
+
+	.text
+	.align	2
+
+# Print the zero-terminated string at a0
+	.type	print_string, @function
+print_string:
+	li	t0, SERIAL
+1:	lbu	t1, 0(a0)
+	beqz	t1, 2f
+	sb	t1, 0(t0)
+	addi	a0, a0, 1
+	j	1b
+2:	ret
+	.size	print_string, .-print_string
+
+# Print a0 as 16 hexadecimal digits
+	.type	print_hex, @function
+print_hex:
+	li	t0, SERIAL
+	li	t1, 60
+1:	srl	t2, a0, t1
+	andi	t2, t2, 0xf
+	addi	t3, t2, '0'
+	sltiu	t4, t2, 10
+	bnez	t4, 2f
+	addi	t3, t2, 'a' - 10
+2:	sb	t3, 0(t0)
+	addi	t1, t1, -4
+	bgez	t1, 1b
+	ret
+	.size	print_hex, .-print_hex
+
+# a0 = a0 * a1, by shifting and adding
+	.globl	__muldi3
+	.type	__muldi3, @function
+__muldi3:
+	mv	t0, a0
+	li	a0, 0
+1:	andi	t1, a1, 1
+	beqz	t1, 2f
+	add	a0, a0, t0
+2:	srli	a1, a1, 1
+	slli	t0, t0, 1
+	bnez	a1, 1b
+	ret
+	.size	__muldi3, .-__muldi3
+
+	.globl	_start
+	.type	_start, @function
+_start:
+	la	sp, _stack + STACK_SIZE
+	call	main
+	mv	s0, a0
+
+	la	a0, message
+	call	print_string
+	mv	a0, s0
+	call	print_hex
+	li	t0, SERIAL
+	li	t1, '\n'
+	sb	t1, 0(t0)
+
+	# end simulation with exit code
+	sw	s0, SYS_HALT(zero)
+	nop
+	nop
+	nop
+	nop
+	nop
+	nop
+	.size	_start, .-_start
+
+	.section .rodata
+message:
+	.string	"checksum: 0x"
+
+	.bss
+	.align	4
+_stack:
+	.zero	STACK_SIZE
@@ -0,0 +1,36 @@
+# Integer loop: a xorshift64 generator drives data-dependent branches
+# and shifts, additions and logical operations on a few registers.
+
+	.equ	ITERATIONS, 100000
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	li	t0, ITERATIONS
+	li	a0, 0
+	li	a1, 0x2545f4914f6cdd1d
+.Lloop:
+	slli	t1, a1, 13
+	xor	a1, a1, t1
+	srli	t1, a1, 7
+	xor	a1, a1, t1
+	slli	t1, a1, 17
+	xor	a1, a1, t1
+
+	andi	t2, a1, 0xff
+	andi	t3, a1, 0x100
+	beqz	t3, .Leven
+	add	a0, a0, t2
+	j	.Lnext
+.Leven:
+	xor	a0, a0, t2
+	slli	a0, a0, 1
+.Lnext:
+	srli	t4, a0, 63
+	or	a0, a0, t4
+	addi	t0, t0, -1
+	bnez	t0, .Lloop
+	ret
+	.size	main, .-main
@@ -0,0 +1,105 @@
+# Matrix multiply: C = A * B for square matrices of 64-bit integers,
+# using the triple loop with the k loop innermost. RV64I has no multiply
+# instruction, so every product calls __muldi3, as compiled code does.
+# The checksum is the sum of the elements of C.
+
+	.equ	N, 32
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	addi	sp, sp, -64
+	sd	ra, 56(sp)
+	sd	s0, 48(sp)
+	sd	s1, 40(sp)
+	sd	s2, 32(sp)
+	sd	s3, 24(sp)
+	sd	s4, 16(sp)
+	sd	s5, 8(sp)
+	sd	s6, 0(sp)
+
+	# A[i][j] = (i + 2j) mod 256, B[i][j] = (3i + j) mod 256
+	la	t0, matrixA
+	la	t1, matrixB
+	li	t2, 0			# i
+1:	li	t3, 0			# j
+2:	slli	t4, t3, 1
+	add	t4, t4, t2
+	andi	t4, t4, 0xff
+	sd	t4, 0(t0)
+	slli	t4, t2, 1
+	add	t4, t4, t2
+	add	t4, t4, t3
+	andi	t4, t4, 0xff
+	sd	t4, 0(t1)
+	addi	t0, t0, 8
+	addi	t1, t1, 8
+	addi	t3, t3, 1
+	li	t5, N
+	bne	t3, t5, 2b
+	addi	t2, t2, 1
+	bne	t2, t5, 1b
+
+	la	s0, matrixA		# row of A
+	la	s1, matrixC		# element of C
+	li	s2, 0			# i
+.Lrow:
+	li	s3, 0			# j
+.Lcolumn:
+	li	s6, 0			# sum
+	mv	s4, s0			# A[i][k]
+	la	s5, matrixB
+	slli	t0, s3, 3
+	add	s5, s5, t0		# B[k][j]
+.Linner:
+	ld	a0, 0(s4)
+	ld	a1, 0(s5)
+	call	__muldi3
+	add	s6, s6, a0
+	addi	s4, s4, 8
+	addi	s5, s5, N * 8
+	sub	t0, s4, s0		# until the end of the row of A
+	li	t1, N * 8
+	bne	t0, t1, .Linner
+
+	sd	s6, 0(s1)
+	addi	s1, s1, 8
+	addi	s3, s3, 1
+	li	t0, N
+	bne	s3, t0, .Lcolumn
+	addi	s0, s0, N * 8
+	addi	s2, s2, 1
+	bne	s2, t0, .Lrow
+
+	# Sum the result
+	la	t0, matrixC
+	li	t1, N * N
+	li	a0, 0
+3:	ld	t2, 0(t0)
+	add	a0, a0, t2
+	addi	t0, t0, 8
+	addi	t1, t1, -1
+	bnez	t1, 3b
+
+	ld	ra, 56(sp)
+	ld	s0, 48(sp)
+	ld	s1, 40(sp)
+	ld	s2, 32(sp)
+	ld	s3, 24(sp)
+	ld	s4, 16(sp)
+	ld	s5, 8(sp)
+	ld	s6, 0(sp)
+	addi	sp, sp, 64
+	ret
+	.size	main, .-main
+
+	.bss
+	.align	3
+matrixA:
+	.zero	N * N * 8
+matrixB:
+	.zero	N * N * 8
+matrixC:
+	.zero	N * N * 8
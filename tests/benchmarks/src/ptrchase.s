@@ -0,0 +1,88 @@
+# Pointer chasing: links 64-byte nodes into a single random cycle
+# (Sattolo's algorithm) and follows the next pointers, such that every
+# load depends on the previous one and consecutive loads hit different
+# cache lines. The checksum sums the indices of the visited nodes.
+
+	.equ	NODES, 8192		/* power of two */
+	.equ	NODE_SIZE, 64
+	.equ	STEPS, 200000
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	# order[i] = i
+	la	a0, order
+	li	t0, 0
+	li	t1, NODES
+1:	slli	t2, t0, 3
+	add	t2, a0, t2
+	sd	t0, 0(t2)
+	addi	t0, t0, 1
+	bne	t0, t1, 1b
+
+	# Sattolo: for i = n - 1 down to 1, swap order[i] with order[j],
+	# j < i, drawn by rejection sampling from the next power of two
+	li	t6, 0x9e3779b97f4a7c15
+	addi	t0, t1, -1		# i
+	li	a1, NODES - 1		# mask
+.Lshuffle:
+	srli	t1, a1, 1
+	bge	t1, t0, 3f		# shrink the mask to cover i - 1
+	j	4f
+3:	mv	a1, t1
+	j	.Lshuffle
+4:	slli	t2, t6, 13
+	xor	t6, t6, t2
+	srli	t2, t6, 7
+	xor	t6, t6, t2
+	slli	t2, t6, 17
+	xor	t6, t6, t2
+	and	t3, t6, a1		# j
+	bge	t3, t0, 4b
+	slli	t4, t0, 3
+	add	t4, a0, t4
+	slli	t5, t3, 3
+	add	t5, a0, t5
+	ld	t2, 0(t4)
+	ld	t3, 0(t5)
+	sd	t3, 0(t4)
+	sd	t2, 0(t5)
+	addi	t0, t0, -1
+	bnez	t0, .Lshuffle
+
+	# node[i].next = &node[order[i]], node[i].index = i
+	la	a2, nodes
+	li	t0, 0
+	li	t1, NODES
+5:	slli	t2, t0, 3
+	add	t2, a0, t2
+	ld	t3, 0(t2)
+	slli	t3, t3, 6
+	add	t3, a2, t3
+	slli	t4, t0, 6
+	add	t4, a2, t4
+	sd	t3, 0(t4)
+	sd	t0, 8(t4)
+	addi	t0, t0, 1
+	bne	t0, t1, 5b
+
+	# Follow the pointers
+	li	t0, STEPS
+	mv	t1, a2
+	li	a0, 0
+6:	ld	t2, 8(t1)
+	add	a0, a0, t2
+	ld	t1, 0(t1)
+	addi	t0, t0, -1
+	bnez	t0, 6b
+	ret
+	.size	main, .-main
+
+	.bss
+	.align	6
+order:
+	.zero	NODES * 8
+nodes:
+	.zero	NODES * NODE_SIZE
@@ -0,0 +1,116 @@
+# Sorting: fills an array with pseudo-random numbers and sorts it with a
+# recursive quicksort (Hoare partitioning, middle pivot). The checksum
+# combines the sorted elements with their positions and is zero if the
+# result is not sorted.
+
+	.equ	COUNT, 8192
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	addi	sp, sp, -16
+	sd	ra, 8(sp)
+
+	# Fill the array using xorshift64
+	la	a0, array
+	li	t0, COUNT
+	li	t1, 0x9e3779b97f4a7c15
+	mv	t5, a0
+1:	slli	t2, t1, 13
+	xor	t1, t1, t2
+	srli	t2, t1, 7
+	xor	t1, t1, t2
+	slli	t2, t1, 17
+	xor	t1, t1, t2
+	sd	t1, 0(t5)
+	addi	t5, t5, 8
+	addi	t0, t0, -1
+	bnez	t0, 1b
+
+	li	a1, 0
+	li	a2, COUNT - 1
+	call	quicksort
+
+	# Verify the order and compute the checksum
+	la	t5, array
+	li	t0, 1
+	li	t1, COUNT
+	ld	a0, 0(t5)
+2:	ld	t2, 0(t5)
+	ld	t3, 8(t5)
+	bltu	t3, t2, 3f
+	xor	t4, t3, t0
+	add	a0, a0, t4
+	slli	t4, a0, 1
+	srli	a0, a0, 63
+	or	a0, a0, t4
+	addi	t5, t5, 8
+	addi	t0, t0, 1
+	bne	t0, t1, 2b
+	j	4f
+3:	li	a0, 0
+4:	ld	ra, 8(sp)
+	addi	sp, sp, 16
+	ret
+	.size	main, .-main
+
+# Sort the unsigned elements a1 up to and including a2 of the array at a0
+	.type	quicksort, @function
+quicksort:
+	bge	a1, a2, .Ldone
+	addi	sp, sp, -32
+	sd	ra, 24(sp)
+	sd	s0, 16(sp)
+	sd	s1, 8(sp)
+	sd	s2, 0(sp)
+	mv	s0, a1
+	mv	s1, a2
+
+	# pivot = array[(lo + hi) / 2]
+	add	t0, a1, a2
+	srli	t0, t0, 1
+	slli	t0, t0, 3
+	add	t0, a0, t0
+	ld	t6, 0(t0)
+
+	addi	t0, a1, -1		# i
+	addi	t1, a2, 1		# j
+.Lpartition:
+1:	addi	t0, t0, 1
+	slli	t2, t0, 3
+	add	t2, a0, t2
+	ld	t3, 0(t2)
+	bltu	t3, t6, 1b
+2:	addi	t1, t1, -1
+	slli	t4, t1, 3
+	add	t4, a0, t4
+	ld	t5, 0(t4)
+	bltu	t6, t5, 2b
+	bge	t0, t1, 3f
+	sd	t5, 0(t2)
+	sd	t3, 0(t4)
+	j	.Lpartition
+
+3:	mv	s2, t1
+	mv	a1, s0
+	mv	a2, s2
+	call	quicksort
+	addi	a1, s2, 1
+	mv	a2, s1
+	call	quicksort
+
+	ld	ra, 24(sp)
+	ld	s0, 16(sp)
+	ld	s1, 8(sp)
+	ld	s2, 0(sp)
+	addi	sp, sp, 32
+.Ldone:
+	ret
+	.size	quicksort, .-quicksort
+
+	.bss
+	.align	3
+array:
+	.zero	COUNT * 8
@@ -0,0 +1,143 @@
+# String processing: builds a text of pseudo-random words and then
+# repeatedly determines its length, reverses every word in place,
+# counts the words and hashes the text with djb2. All accesses are byte
+# loads and stores.
+
+	.equ	SIZE, 8192
+	.equ	ROUNDS, 4
+
+	.text
+	.align	2
+	.globl	main
+	.type	main, @function
+main:
+	addi	sp, sp, -32
+	sd	ra, 24(sp)
+	sd	s0, 16(sp)
+	sd	s1, 8(sp)
+	sd	s2, 0(sp)
+
+	# Words of 1 to 8 letters out of 16, separated by a space
+	la	t0, text
+	li	t1, SIZE - 10
+	add	t1, t0, t1		# end
+	li	t2, 0x2545f4914f6cdd1d
+1:	slli	t3, t2, 13
+	xor	t2, t2, t3
+	srli	t3, t2, 7
+	xor	t2, t2, t3
+	slli	t3, t2, 17
+	xor	t2, t2, t3
+	andi	t3, t2, 7		# length - 1
+	srli	t4, t2, 8
+2:	andi	t5, t4, 15
+	addi	t5, t5, 'a'
+	sb	t5, 0(t0)
+	addi	t0, t0, 1
+	srli	t4, t4, 4
+	addi	t3, t3, -1
+	bgez	t3, 2b
+	li	t5, ' '
+	sb	t5, 0(t0)
+	addi	t0, t0, 1
+	bltu	t0, t1, 1b
+	sb	zero, -1(t0)
+
+	li	s0, ROUNDS
+	li	s1, 0			# checksum
+.Lround:
+	la	a0, text
+	call	strlen
+	add	s1, s1, a0
+
+	la	a0, text
+	call	reverse_words
+	add	s1, s1, a0
+
+	la	a0, text
+	call	djb2
+	xor	s1, s1, a0
+	slli	t0, s1, 7
+	srli	s1, s1, 57
+	or	s1, s1, t0
+
+	addi	s0, s0, -1
+	bnez	s0, .Lround
+
+	mv	a0, s1
+	ld	ra, 24(sp)
+	ld	s0, 16(sp)
+	ld	s1, 8(sp)
+	ld	s2, 0(sp)
+	addi	sp, sp, 32
+	ret
+	.size	main, .-main
+
+# Length of the string at a0
+	.type	strlen, @function
+strlen:
+	mv	t0, a0
+1:	lbu	t1, 0(t0)
+	addi	t0, t0, 1
+	bnez	t1, 1b
+	sub	a0, t0, a0
+	addi	a0, a0, -1
+	ret
+	.size	strlen, .-strlen
+
+# Reverse the space-separated words of the string at a0 in place,
+# returns the number of words
+	.type	reverse_words, @function
+reverse_words:
+	li	a1, 0
+	li	t6, ' '
+.Lword:
+	lbu	t1, 0(a0)
+	beqz	t1, .Lend
+	beq	t1, t6, .Lspace
+	# find the end of the word
+	mv	t0, a0
+1:	addi	t0, t0, 1
+	lbu	t1, 0(t0)
+	beqz	t1, 2f
+	bne	t1, t6, 1b
+2:	mv	a2, t0
+	addi	t0, t0, -1
+	# swap from both ends
+3:	bgeu	a0, t0, 4f
+	lbu	t2, 0(a0)
+	lbu	t3, 0(t0)
+	sb	t3, 0(a0)
+	sb	t2, 0(t0)
+	addi	a0, a0, 1
+	addi	t0, t0, -1
+	j	3b
+4:	mv	a0, a2
+	addi	a1, a1, 1
+	j	.Lword
+.Lspace:
+	addi	a0, a0, 1
+	j	.Lword
+.Lend:
+	mv	a0, a1
+	ret
+	.size	reverse_words, .-reverse_words
+
+# djb2 hash of the string at a0: h = h * 33 + c
+	.type	djb2, @function
+djb2:
+	li	t0, 5381
+1:	lbu	t1, 0(a0)
+	beqz	t1, 2f
+	slli	t2, t0, 5
+	add	t0, t0, t2
+	add	t0, t0, t1
+	addi	a0, a0, 1
+	j	1b
+2:	mv	a0, t0
+	ret
+	.size	djb2, .-djb2
+
+	.bss
+text:
+	.zero	SIZE